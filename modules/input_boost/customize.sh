@@ -24,6 +24,11 @@ set_perm "$MODPATH/input_boost_daemon.sh" 0 0 0755
 if [ -f "$MODPATH/input_boost_daemon" ]; then
     set_perm "$MODPATH/input_boost_daemon" 0 0 0755
     ui_print "- Native binary daemon found"
+else
+    # The binary is built by CI (native/Makefile "module"), never committed
+    ui_print "! Native daemon not bundled in this ZIP"
+    ui_print "  Falling back to input_boost_daemon.sh, which only reads"
+    ui_print "  BOOST_FREQ, DURATION_MS, COOLDOWN_MS and TARGET_CPUS"
 fi
 
 # Check for cpufreq support
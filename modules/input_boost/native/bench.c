@@ -0,0 +1,165 @@
+/*
+ * Host benchmark for the input boost daemon
+ * Builds the daemon with CPU_SYSFS_DIR pointed at a fake cpufreq tree and
+ * times a touch from the evdev write to the finished scaling_min_freq write,
+ * with serial writes or with USE_IO_URING's batch
+ * Usage: make bench [BENCH_RUNS=n]
+ */
+
+#define main input_boost_main
+#include "input_boost.c"
+#undef main
+
+#define BENCH_RUNS 20000
+
+struct fake_policy {
+    int id;
+    const char *cpus;
+    int max_freq;
+};
+
+/* A 4+3+1 phone layout; only the two big policies are boosted */
+static const struct fake_policy fake_policies[] = {
+    { 0, "0 1 2 3", 1800000 },
+    { 4, "4 5 6", 2400000 },
+    { 7, "7", 2840000 },
+};
+
+static int write_fake(const char *dir, const char *name, const char *value)
+{
+    char path[MAX_PATH];
+    FILE *fp;
+
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path))
+        return -1;
+    fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+    fprintf(fp, "%s\n", value);
+    fclose(fp);
+    return 0;
+}
+
+static int make_fake_tree(void)
+{
+    char dir[MAX_PATH], value[32];
+
+    if (system("rm -rf '" CPU_SYSFS_DIR "' && mkdir -p '" CPUFREQ_SYSFS_DIR "'") != 0)
+        return -1;
+    if (write_fake(CPU_SYSFS_DIR, "online", "0-7") < 0)
+        return -1;
+
+    for (size_t i = 0; i < sizeof(fake_policies) / sizeof(fake_policies[0]); i++) {
+        const struct fake_policy *fp = &fake_policies[i];
+
+        snprintf(dir, sizeof(dir), "%s/policy%d", CPUFREQ_SYSFS_DIR, fp->id);
+        if (mkdir(dir, 0755) < 0)
+            return -1;
+        snprintf(value, sizeof(value), "%d", fp->max_freq);
+        write_fake(dir, "related_cpus", fp->cpus);
+        write_fake(dir, "cpuinfo_max_freq", value);
+        write_fake(dir, "scaling_max_freq", value);
+        write_fake(dir, "scaling_min_freq", "300000");
+    }
+    return 0;
+}
+
+static void put_event(int fd, int type, int code, int value)
+{
+    struct input_event ie = { .type = type, .code = code, .value = value };
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ie.input_event_sec = now.tv_sec;
+    ie.input_event_usec = now.tv_nsec / 1000;
+    if (write(fd, &ie, sizeof(ie)) != sizeof(ie))
+        perror("write");
+}
+
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static long run_touch(struct input_device *dev, int tx, int tracking_id)
+{
+    struct timespec start, done;
+
+    // Each run starts unboosted, as a touch after the boost has expired
+    g_request_count = 0;
+    restore_original_freqs();
+    g_last_boost = (struct timespec){0, 0};
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    put_event(tx, EV_ABS, ABS_MT_SLOT, 0);
+    put_event(tx, EV_ABS, ABS_MT_TRACKING_ID, tracking_id);
+    put_event(tx, EV_KEY, BTN_TOUCH, 1);
+    put_event(tx, EV_SYN, SYN_REPORT, 0);
+    clock_gettime(CLOCK_MONOTONIC, &g_wakeup);
+    handle_input(dev);
+    clock_gettime(CLOCK_MONOTONIC, &done);
+
+    put_event(tx, EV_ABS, ABS_MT_TRACKING_ID, -1);
+    put_event(tx, EV_KEY, BTN_TOUCH, 0);
+    put_event(tx, EV_SYN, SYN_REPORT, 0);
+    handle_input(dev);
+
+    return (done.tv_sec - start.tv_sec) * 1000000000L + (done.tv_nsec - start.tv_nsec);
+}
+
+int main(int argc, char **argv)
+{
+    int runs = argc > 1 ? atoi(argv[1]) : BENCH_RUNS;
+    int use_io_uring = argc > 2 && strcmp(argv[2], "uring") == 0;
+    int pipefd[2];
+
+    if (runs <= 0)
+        runs = BENCH_RUNS;
+    if (make_fake_tree() < 0) {
+        fprintf(stderr, "Cannot create fake tree under %s: %s\n", CPU_SYSFS_DIR, strerror(errno));
+        return 1;
+    }
+
+    g_log_fd = STDERR_FILENO;
+    g_config.log_level = LOG_ERROR;
+    g_config.cooldown_ms = 0;
+    if (detect_cpus() < 0)
+        return 1;
+    select_boost_opps();
+    if (use_io_uring && uring_setup() < 0) {
+        fprintf(stderr, "io_uring_setup failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    g_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_timer_fd < 0 || pipe2(pipefd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        perror("setup");
+        return 1;
+    }
+
+    struct input_device *dev = &g_devices[g_device_count++];
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = pipefd[0];
+    dev->cls = INPUT_CLASS_TOUCH;
+    snprintf(dev->name, sizeof(dev->name), "bench");
+
+    long *samples = calloc(runs, sizeof(*samples));
+    if (!samples)
+        return 1;
+    for (int i = 0; i < runs; i++)
+        samples[i] = run_touch(dev, pipefd[1], i);
+    qsort(samples, runs, sizeof(*samples), compare_long);
+
+    int targets = 0;
+    for (int i = 0; i < g_policy_count; i++)
+        targets += g_policies[i].is_target;
+    printf("touch-to-frequency over %d runs, %d boosted policies, %s writes:\n", runs, targets,
+           use_io_uring ? "io_uring" : "serial");
+    printf("  p50 %.2f us  p90 %.2f us  p99 %.2f us\n",
+           samples[runs / 2] / 1000.0, samples[runs * 9 / 10] / 1000.0,
+           samples[runs * 99 / 100] / 1000.0);
+
+    free(samples);
+    return 0;
+}
@@ -1,7 +1,7 @@
 /*
  * Input Boost Daemon for Android
  * High-performance C implementation using epoll/timerfd/signalfd
- * Boosts CPU frequency on touch input for improved responsiveness
+ * Boosts CPU frequency on touch, key, gamepad and rotary input for improved responsiveness
  */
 
 #include <stdio.h>
@@ -14,67 +14,446 @@
 #include <dirent.h>
 #include <time.h>
 #include <stdarg.h>
+#include <sched.h>
+#include <limits.h>
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 #include <sys/signalfd.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/inotify.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <stddef.h>
 #include <linux/input.h>
+#include <linux/netlink.h>
+#include <linux/io_uring.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 
-#define MAX_CPUS 32
+#define MAX_CPUS 64
+#define MAX_POLICIES 16
 #define MAX_PATH 256
 #define MAX_LINE 512
-#define MAX_EVENTS 4
+#define MAX_EVENTS 16
 #define MAX_LOG_SIZE 102400
 #define BIG_LITTLE_THRESHOLD 2000000
+#define UEVENT_BUF_SIZE 2048
+#define MAX_WRITES 32
+#define MAX_INPUT_DEVICES 32
+#define INOTIFY_BUF_SIZE 1024
+#define INPUT_BATCH 64
+#define MAX_SLOTS 64
+#define MAX_RAMP_STEPS 8
+#define FLING_WINDOW_US 100000
+#define MAX_DEVFREQ 8
+#define HIST_BUCKETS 24
+#define MAX_CLIENTS 4           /* the last slot is kept for root */
+#define MAX_UID_CLIENTS 1       /* connections per non-root uid */
+#define CLIENT_IDLE_MS 5000     /* silent clients are dropped after this */
+#define CONTROL_BUF_SIZE 256
+#define MAX_REQUESTS 16
+#define MAX_REQUEST_MS 10000    /* longest boost a non-root client may ask for */
+#define MAX_UID_REQUESTS 2      /* live requests per non-root uid */
+#define INPUT_REQUEST_ID 0
+#define LAUNCH_REQUEST_ID 1
+#define PRESSURE_REQUEST_ID 2
+#define FIRST_CLIENT_ID 3
+#define PARENT_CACHE 16
+#define MAX_THERMAL_ZONES 8
+#define MAX_THERMAL_STEPS 8
+#define MAX_OPPS 32
+#define CAPACITY_SCALE 1024
+#define PREFAULT_STACK (128 * 1024)
+
+/* Not in every libc's headers; the value is the kernel ABI */
+#ifndef SCHED_FLAG_UTIL_CLAMP_MIN
+#define SCHED_FLAG_UTIL_CLAMP_MIN 0x20
+#endif
+#define PROC_CN_BUF_SIZE 4096
+
+/* Overridable so the daemon can be pointed at a fake sysfs tree off-device */
+#ifndef CPU_SYSFS_DIR
+#define CPU_SYSFS_DIR "/sys/devices/system/cpu"
+#endif
+#define CPUFREQ_SYSFS_DIR CPU_SYSFS_DIR "/cpufreq"
+
+/* Abstract unix socket; the leading NUL is added when binding */
+#ifndef CONTROL_SOCKET
+#define CONTROL_SOCKET "input_boost"
+#endif
+
+#ifndef DEVFREQ_SYSFS_DIR
+#define DEVFREQ_SYSFS_DIR "/sys/class/devfreq"
+#endif
+
+/* debugfs; usually only mounted on eng/userdebug builds */
+#ifndef ENERGY_MODEL_DIR
+#define ENERGY_MODEL_DIR "/sys/kernel/debug/energy_model"
+#endif
+
+#ifndef THERMAL_SYSFS_DIR
+#define THERMAL_SYSFS_DIR "/sys/class/thermal"
+#endif
+
+#ifndef PSI_DIR
+#define PSI_DIR "/proc/pressure"
+#endif
+
+#ifndef UCLAMP_TOP_APP
+#define UCLAMP_TOP_APP "/dev/cpuctl/top-app/cpu.uclamp.min"
+#endif
+
+#ifndef INPUT_DEV_DIR
+#define INPUT_DEV_DIR "/dev/input"
+#endif
+
+#define BITS_PER_LONG (8 * sizeof(unsigned long))
+#define BITS_TO_LONGS(n) (((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
 
 #define LOG_ERROR 0
 #define LOG_INFO  1
 #define LOG_DEBUG 2
 
-static const char *MODULE_DIR = "/data/adb/modules/input_boost";
 static const char *CONFIG_FILE = "/data/adb/modules/input_boost/config.conf";
 static const char *LOG_FILE = "/data/adb/modules/input_boost/daemon.log";
 static const char *PID_FILE = "/data/adb/modules/input_boost/daemon.pid";
 static const char *ORIG_FREQ_FILE = "/data/adb/modules/input_boost/.orig_freqs";
+static const char *STATS_FILE = "/data/adb/modules/input_boost/stats";
+
+/* What a boost raises: policy scaling_min_freq, or top-app's uclamp.min */
+enum boost_backend {
+    BACKEND_CPUFREQ,
+    BACKEND_UCLAMP
+};
+
+/* linux/sched/types.h's struct sched_attr; that header clashes with <sched.h> */
+struct sched_attr_uclamp {
+    __u32 size;
+    __u32 sched_policy;
+    __u64 sched_flags;
+    __s32 sched_nice;
+    __u32 sched_priority;
+    __u64 sched_runtime;
+    __u64 sched_deadline;
+    __u64 sched_period;
+    __u32 sched_util_min;
+    __u32 sched_util_max;
+};
+
+/* Resources with a PSI trigger */
+enum psi_resource {
+    PSI_CPU,
+    PSI_MEMORY,
+    PSI_COUNT
+};
 
 struct config {
+    int backend;
     int boost_freq;
+    int boost_capacity;     /* 0 = boost to max; else 1..1024 of the biggest CPU */
     int duration_ms;
     int cooldown_ms;
     char target_cpus[32];
     int enabled;
     int log_level;
+    int use_io_uring;
+    int hold_while_touching;
+    int ramp_steps[MAX_RAMP_STEPS];  /* % of the boost above original, descending */
+    int ramp_count;
+    int ramp_step_ms;
+    int drag_slop;          /* % of the screen */
+    int fling_velocity;     /* % of the screen per second */
+    char devfreq_match[MAX_DEVFREQ][64];
+    unsigned long devfreq_floor[MAX_DEVFREQ];   /* 0 = max_freq */
+    int devfreq_count;
+    int launch_duration_ms;     /* 0 = no launch boost */
+    int launch_freq;            /* kHz, 0 = BOOST_FREQ */
+    char launch_parents[64];
+    int psi_stall_us[PSI_COUNT];    /* "some" stall per window, 0 = no trigger */
+    int psi_window_us;
+    int psi_hold_ms;
+    int psi_freq;                   /* kHz, 0 = BOOST_FREQ */
+    char thermal_zones[64];         /* comma-separated substrings of zone types */
+    int thermal_temps[MAX_THERMAL_STEPS];   /* m°C, ascending */
+    int thermal_caps[MAX_THERMAL_STEPS];    /* % of max_freq from that temperature up */
+    int thermal_count;
+    int thermal_trip;               /* m°C, 0 = never skip */
+    int thermal_poll_ms;
+    int realtime;
+    int rt_priority;
+    char pin_cpus[32];
 };
 
-struct cpu_info {
-    int cpu_id;
+/* One cpufreq policy (cluster); every CPU in related_cpus shares its limits */
+struct cpu_policy {
+    int policy_id;
+    char label[16];
+    int first_cpu;
+    unsigned long long cpus;
     int orig_min_freq;
     int max_freq;
     int is_big;
-    int is_online;
     int is_target;
+    int min_fd;
+    int max_fd;
+    int limit_freq;     /* scaling_max_freq at the last thermal check */
+    int opps[MAX_OPPS];                 /* scaling_available_frequencies, ascending */
+    unsigned long opp_cost[MAX_OPPS];   /* energy model cost, 0 = unknown */
+    int opp_count;
+    int capacity;       /* cpu_capacity at max_freq */
+    int boost_opp;      /* what a "max" boost writes; see select_boost_opps() */
+};
+
+/* Input device classes; each gets its own boost policy */
+enum input_class {
+    INPUT_CLASS_NONE = -1,
+    INPUT_CLASS_TOUCH,
+    INPUT_CLASS_STYLUS,
+    INPUT_CLASS_KEYBOARD,
+    INPUT_CLASS_GAMEPAD,
+    INPUT_CLASS_ROTARY,
+    INPUT_CLASS_COUNT
+};
+
+/* Touch gestures, in escalating order; a gesture only ever moves up */
+enum gesture {
+    GESTURE_TAP,
+    GESTURE_DRAG,
+    GESTURE_FLING,
+    GESTURE_COUNT
+};
+
+struct gesture_level {
+    const char *name;
+    const char *freq_key;
+    const char *duration_key;
+    int freq;           /* kHz, 0 = BOOST_FREQ */
+    int duration_ms;    /* 0 = the device class duration */
+};
+
+struct class_policy {
+    const char *name;
+    const char *duration_key;
+    int enabled;
+    int duration_ms;    /* 0 = DURATION_MS */
+};
+
+struct input_device {
+    int fd;
+    int num;            /* N in /dev/input/eventN */
+    int cls;
+    char name[64];
+    /* Touch/stylus state, updated per event and evaluated per SYN_REPORT frame */
+    int slot;
+    unsigned long long contacts;    /* MT slots with a live tracking id */
+    int touching;                   /* BTN_TOUCH */
+    int in_range;                   /* BTN_TOOL_PEN, so a hovering pen pre-boosts */
+    int down;
+    int dropped;
+    int frames;
+    /* Tracked contact, in device units; ranges normalize them to the screen */
+    int mt;                         /* positions come from ABS_MT_POSITION_* */
+    int track_slot;
+    int range_x, range_y;
+    int x, y;
+    int moved;                      /* tracked contact moved in this frame */
+    int resample;                   /* next position is a new baseline, not motion */
+    int start_x, start_y;
+    int last_x, last_y;
+    long long last_move_us;
+    int velocity;                   /* permille of the screen per second */
+    int gesture;
 };
 
 static struct config g_config = {
+    .backend = BACKEND_CPUFREQ,
     .boost_freq = 0,
+    .boost_capacity = 0,
     .duration_ms = 500,
     .cooldown_ms = 100,
     .target_cpus = "big",
     .enabled = 1,
-    .log_level = LOG_INFO
+    .log_level = LOG_INFO,
+    .use_io_uring = 0,
+    .hold_while_touching = 0,
+    .ramp_count = 0,
+    .ramp_step_ms = 50,
+    .drag_slop = 2,
+    .fling_velocity = 150,
+    .launch_duration_ms = 0,
+    .launch_freq = 0,
+    .launch_parents = "zygote64,zygote",
+    .psi_stall_us = { [PSI_CPU] = 0, [PSI_MEMORY] = 0 },
+    .psi_window_us = 1000000,
+    .psi_hold_ms = 1000,
+    .psi_freq = 0,
+    .thermal_zones = "cpu",
+    .thermal_count = 0,
+    .thermal_trip = 0,
+    .thermal_poll_ms = 1000,
+    .realtime = 0,
+    .rt_priority = 1,
+    .pin_cpus = ""
+};
+
+/* A devfreq device (GPU, bus bandwidth) whose min_freq is raised with the CPUs */
+struct devfreq_dev {
+    char name[128];
+    int min_fd;
+    unsigned long orig_min_freq;
+    unsigned long boost_freq;
+};
+
+/* log2 histogram of microseconds: bucket i holds [2^i, 2^(i+1)), bucket 0 also < 1 */
+struct latency_hist {
+    unsigned long long buckets[HIST_BUCKETS];
+    unsigned long long count;
+    unsigned long long sum_us;
+    long max_us;
+};
+
+/* Dumped to STATS_FILE on SIGUSR1 and at exit */
+struct stats {
+    struct timespec started;
+    unsigned long long boosts;
+    unsigned long long cooldown_suppressed;
+    unsigned long long launches;
+    unsigned long long pressure_holds;
+    unsigned long long thermal_skipped;
+    unsigned long long write_failures;
+    long long boosted_us;
+    struct timespec boost_began;        /* zero when not boosted */
+    struct latency_hist event_to_wakeup;
+    struct latency_hist wakeup_to_write;
+    struct latency_hist event_to_write;
+};
+
+struct control_client {
+    int fd;
+    uid_t uid;
+    long long last_active;  /* monotonic ms of the last read */
+    int len;
+    char buf[CONTROL_BUF_SIZE];
+};
+
+/* One outstanding boost; input and launch hold fixed ids, clients get the rest */
+struct boost_request {
+    unsigned int id;
+    uid_t uid;
+    int priority;
+    int freq;               /* kHz, 0 = max */
+    long long until_ms;
+    char owner[24];
+};
+
+/* An armed PSI trigger; fires when stall time in a window crosses the threshold */
+struct psi_trigger {
+    const char *name;
+    const char *stall_key;
+    int fd;
+    int stall_us;       /* what the fd was armed with */
+    int window_us;
+};
+
+struct thermal_zone {
+    char type[32];
+    int fd;             /* temp, in m°C */
 };
 
-static struct cpu_info g_cpus[MAX_CPUS];
-static int g_cpu_count = 0;
+/* Whether a pid runs one of LAUNCH_PARENTS, kept until it execs or exits */
+struct proc_parent {
+    pid_t pid;
+    int is_launcher;
+};
+
+/* One queued sysfs write; a boost or restore is a batch of these */
+struct sysfs_write {
+    int fd;
+    const char *label;
+    struct iovec iov;
+    char buf[16];
+};
+
+struct uring {
+    int fd;
+    unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_len, cq_ring_len, sqes_len;
+};
+
+static struct class_policy g_class_policies[INPUT_CLASS_COUNT] = {
+    [INPUT_CLASS_TOUCH]    = { "touch",    "TOUCH_DURATION_MS",    1, 0 },
+    [INPUT_CLASS_STYLUS]   = { "stylus",   "STYLUS_DURATION_MS",   1, 0 },
+    [INPUT_CLASS_KEYBOARD] = { "keyboard", "KEYBOARD_DURATION_MS", 1, 0 },
+    [INPUT_CLASS_GAMEPAD]  = { "gamepad",  "GAMEPAD_DURATION_MS",  1, 0 },
+    [INPUT_CLASS_ROTARY]   = { "rotary",   "ROTARY_DURATION_MS",   1, 0 }
+};
+
+static struct gesture_level g_gesture_levels[GESTURE_COUNT] = {
+    [GESTURE_TAP]   = { "tap",   "TAP_FREQ",   "TAP_DURATION_MS",   0, 0 },
+    [GESTURE_DRAG]  = { "drag",  "DRAG_FREQ",  "DRAG_DURATION_MS",  0, 0 },
+    [GESTURE_FLING] = { "fling", "FLING_FREQ", "FLING_DURATION_MS", 0, 0 }
+};
+
+static struct cpu_policy g_policies[MAX_POLICIES];
+static int g_policy_count = 0;
+static unsigned long long g_online_cpus = ~0ULL;
+static int g_boosted = 0;
+static int g_boost_khz = 0;     /* frequency of the running boost, 0 = max */
+static struct devfreq_dev g_devfreqs[MAX_DEVFREQ];
+static int g_devfreq_count = 0;
+static int g_uclamp_fd = -1;
+static int g_uclamp_orig = 0;   /* hundredths of a percent */
+static int g_uclamp_max_khz = 0;
+static int g_ramp_pct = 0;      /* level while ramping down, 0 when not */
+static int g_ramp_step = 0;
 static int g_epoll_fd = -1;
-static int g_input_fd = -1;
+static struct input_device g_devices[MAX_INPUT_DEVICES];
+static int g_device_count = 0;
+static int g_inotify_fd = -1;
+static int g_input_wd = -1;
+static int g_config_wd = -1;
+static int g_control_fd = -1;
+static struct control_client g_clients[MAX_CLIENTS];
+static int g_client_count = 0;
+static int g_uevent_fd = -1;
+static struct uring g_ring = { .fd = -1 };
+static struct sysfs_write g_writes[MAX_WRITES];
+static int g_write_count = 0;
 static int g_timer_fd = -1;
 static int g_signal_fd = -1;
 static int g_log_fd = -1;
 static int g_lock_fd = -1;
 static volatile int g_running = 1;
 static struct timespec g_last_boost = {0, 0};
+static struct timespec g_wakeup = {0, 0};   /* when epoll_wait last returned */
+static struct stats g_stats;
+static struct boost_request g_requests[MAX_REQUESTS];  /* sorted by until_ms */
+static int g_request_count = 0;
+static unsigned int g_next_request_id = FIRST_CLIENT_ID;
+static int g_proc_fd = -1;
+static struct proc_parent g_parents[PARENT_CACHE];
+static int g_parent_next = 0;
+static pid_t g_last_launch = 0;
+static struct thermal_zone g_zones[MAX_THERMAL_ZONES];
+static int g_zone_count = 0;
+static int g_temp = 0;              /* hottest matched zone, m°C */
+static int g_thermal_pct = 100;     /* boost cap from THERMAL_CURVE */
+static int g_thermal_tripped = 0;
+static long long g_thermal_checked_ms = 0;
+static struct psi_trigger g_psi[PSI_COUNT] = {
+    [PSI_CPU]    = { "cpu",    "PSI_CPU_STALL_US",    -1, 0, 0 },
+    [PSI_MEMORY] = { "memory", "PSI_MEMORY_STALL_US", -1, 0, 0 }
+};
 
 static void log_rotate(void)
 {
@@ -101,7 +480,9 @@ static void log_msg(int level, const char *fmt, ...)
     log_rotate();
 
     time_t now = time(NULL);
-    struct tm *tm = localtime(&now);
+    // localtime() re-checks the timezone file on every call
+    struct tm tm_buf;
+    struct tm *tm = localtime_r(&now, &tm_buf);
     if (!tm)
         return;
 
@@ -126,6 +507,14 @@ static void log_msg(int level, const char *fmt, ...)
     write(g_log_fd, buf, len);
 }
 
+static long long monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
 static int read_int_file(const char *path, int *value)
 {
     int fd = open(path, O_RDONLY);
@@ -158,6 +547,14 @@ static int write_int_file(const char *path, int value)
     return (n == len) ? 0 : -1;
 }
 
+static int pwrite_int(int fd, int value)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%d", value);
+
+    return (pwrite(fd, buf, len, 0) == len) ? 0 : -1;
+}
+
 static int read_string_file(const char *path, char *buf, size_t size)
 {
     int fd = open(path, O_RDONLY);
@@ -177,8 +574,383 @@ static int read_string_file(const char *path, char *buf, size_t size)
     return 0;
 }
 
+/* Builds dir/entry/attr; fails instead of truncating a long directory entry */
+static int sysfs_attr_path(char *path, size_t size, const char *dir, const char *entry,
+                           const char *attr)
+{
+    int len = snprintf(path, size, "%s/%s/%s", dir, entry, attr);
+
+    return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+/* RAMP_STEPS is a comma-separated list of percentages, e.g. "60,30" */
+static void parse_ramp_steps(char *value)
+{
+    char *saveptr = NULL;
+
+    g_config.ramp_count = 0;
+    for (char *tok = strtok_r(value, ", ", &saveptr); tok; tok = strtok_r(NULL, ", ", &saveptr)) {
+        int pct = atoi(tok);
+        int prev = g_config.ramp_count ? g_config.ramp_steps[g_config.ramp_count - 1] : 100;
+
+        if (pct <= 0 || pct >= prev || g_config.ramp_count >= MAX_RAMP_STEPS) {
+            log_msg(LOG_ERROR, "Ignoring RAMP_STEPS entry %s", tok);
+            continue;
+        }
+        g_config.ramp_steps[g_config.ramp_count++] = pct;
+    }
+}
+
+/*
+ * DEVFREQ_BOOST may be repeated, one "<device> <min_freq>" per line. The
+ * device is a substring of the /sys/class/devfreq entry name, since those
+ * embed bus addresses; "max" boosts to the device's max_freq.
+ */
+static void parse_devfreq_boost(char *value)
+{
+    char *saveptr = NULL;
+    char *match = strtok_r(value, " \t", &saveptr);
+    char *freq = strtok_r(NULL, " \t", &saveptr);
+
+    if (!match || !freq || g_config.devfreq_count >= MAX_DEVFREQ) {
+        log_msg(LOG_ERROR, "Ignoring DEVFREQ_BOOST entry: %s", value);
+        return;
+    }
+
+    int i = g_config.devfreq_count++;
+    snprintf(g_config.devfreq_match[i], sizeof(g_config.devfreq_match[i]), "%s", match);
+    g_config.devfreq_floor[i] = strcmp(freq, "max") == 0 ? 0 : strtoul(freq, NULL, 10);
+}
+
+/* THERMAL_CURVE is "temp:pct,..." with rising temperatures and falling caps */
+static void parse_thermal_curve(char *value)
+{
+    char *saveptr = NULL;
+
+    g_config.thermal_count = 0;
+    for (char *tok = strtok_r(value, ", ", &saveptr); tok; tok = strtok_r(NULL, ", ", &saveptr)) {
+        int n = g_config.thermal_count;
+        int temp, pct;
+
+        if (sscanf(tok, "%d:%d", &temp, &pct) != 2 || pct <= 0 || pct > 100 || n >= MAX_THERMAL_STEPS ||
+            (n && (temp <= g_config.thermal_temps[n - 1] || pct >= g_config.thermal_caps[n - 1]))) {
+            log_msg(LOG_ERROR, "Ignoring THERMAL_CURVE entry %s", tok);
+            continue;
+        }
+        g_config.thermal_temps[n] = temp;
+        g_config.thermal_caps[n] = pct;
+        g_config.thermal_count++;
+    }
+}
+
+/* BOOST_CLASSES is a comma-separated list; classes not named get no boost */
+static void parse_boost_classes(char *value)
+{
+    char *saveptr = NULL;
+
+    for (int c = 0; c < INPUT_CLASS_COUNT; c++)
+        g_class_policies[c].enabled = 0;
+
+    for (char *tok = strtok_r(value, ", ", &saveptr); tok; tok = strtok_r(NULL, ", ", &saveptr)) {
+        int c;
+        for (c = 0; c < INPUT_CLASS_COUNT; c++) {
+            if (strcmp(tok, g_class_policies[c].name) == 0) {
+                g_class_policies[c].enabled = 1;
+                break;
+            }
+        }
+        if (c == INPUT_CLASS_COUNT)
+            log_msg(LOG_ERROR, "Unknown input class in BOOST_CLASSES: %s", tok);
+    }
+}
+
+/* Applies one KEY=VALUE; returns -1 for an unknown key */
+static int apply_config_key(const char *key, char *value)
+{
+    if (strcmp(key, "BOOST_BACKEND") == 0) {
+        if (strcmp(value, "uclamp") == 0)
+            g_config.backend = BACKEND_UCLAMP;
+        else if (strcmp(value, "cpufreq") == 0)
+            g_config.backend = BACKEND_CPUFREQ;
+        else
+            log_msg(LOG_ERROR, "Unknown BOOST_BACKEND: %s", value);
+    } else if (strcmp(key, "BOOST_FREQ") == 0) {
+        g_config.boost_freq = atoi(value);
+    } else if (strcmp(key, "BOOST_CAPACITY") == 0) {
+        g_config.boost_capacity = atoi(value);
+    } else if (strcmp(key, "DURATION_MS") == 0) {
+        g_config.duration_ms = atoi(value);
+    } else if (strcmp(key, "COOLDOWN_MS") == 0) {
+        g_config.cooldown_ms = atoi(value);
+    } else if (strcmp(key, "TARGET_CPUS") == 0) {
+        strncpy(g_config.target_cpus, value, sizeof(g_config.target_cpus) - 1);
+        g_config.target_cpus[sizeof(g_config.target_cpus) - 1] = '\0';
+    } else if (strcmp(key, "LOG_LEVEL") == 0) {
+        if (strcmp(value, "error") == 0 || strcmp(value, "0") == 0)
+            g_config.log_level = LOG_ERROR;
+        else if (strcmp(value, "info") == 0 || strcmp(value, "1") == 0)
+            g_config.log_level = LOG_INFO;
+        else if (strcmp(value, "debug") == 0 || strcmp(value, "2") == 0)
+            g_config.log_level = LOG_DEBUG;
+    } else if (strcmp(key, "ENABLED") == 0) {
+        g_config.enabled = atoi(value);
+    } else if (strcmp(key, "USE_IO_URING") == 0) {
+        g_config.use_io_uring = atoi(value);
+    } else if (strcmp(key, "HOLD_WHILE_TOUCHING") == 0) {
+        g_config.hold_while_touching = atoi(value);
+    } else if (strcmp(key, "RAMP_STEPS") == 0) {
+        parse_ramp_steps(value);
+    } else if (strcmp(key, "RAMP_STEP_MS") == 0) {
+        g_config.ramp_step_ms = atoi(value);
+    } else if (strcmp(key, "BOOST_CLASSES") == 0) {
+        parse_boost_classes(value);
+    } else if (strcmp(key, "DEVFREQ_BOOST") == 0) {
+        parse_devfreq_boost(value);
+    } else if (strcmp(key, "DRAG_SLOP") == 0) {
+        g_config.drag_slop = atoi(value);
+    } else if (strcmp(key, "FLING_VELOCITY") == 0) {
+        g_config.fling_velocity = atoi(value);
+    } else if (strcmp(key, "LAUNCH_DURATION_MS") == 0) {
+        g_config.launch_duration_ms = atoi(value);
+    } else if (strcmp(key, "LAUNCH_FREQ") == 0) {
+        g_config.launch_freq = atoi(value);
+    } else if (strcmp(key, "REALTIME") == 0) {
+        g_config.realtime = atoi(value);
+    } else if (strcmp(key, "RT_PRIORITY") == 0) {
+        g_config.rt_priority = atoi(value);
+    } else if (strcmp(key, "PIN_CPUS") == 0) {
+        strncpy(g_config.pin_cpus, value, sizeof(g_config.pin_cpus) - 1);
+        g_config.pin_cpus[sizeof(g_config.pin_cpus) - 1] = '\0';
+    } else if (strcmp(key, "THERMAL_ZONES") == 0) {
+        strncpy(g_config.thermal_zones, value, sizeof(g_config.thermal_zones) - 1);
+        g_config.thermal_zones[sizeof(g_config.thermal_zones) - 1] = '\0';
+    } else if (strcmp(key, "THERMAL_CURVE") == 0) {
+        parse_thermal_curve(value);
+    } else if (strcmp(key, "THERMAL_TRIP") == 0) {
+        g_config.thermal_trip = atoi(value);
+    } else if (strcmp(key, "THERMAL_POLL_MS") == 0) {
+        g_config.thermal_poll_ms = atoi(value);
+    } else if (strcmp(key, "PSI_WINDOW_US") == 0) {
+        g_config.psi_window_us = atoi(value);
+    } else if (strcmp(key, "PSI_HOLD_MS") == 0) {
+        g_config.psi_hold_ms = atoi(value);
+    } else if (strcmp(key, "PSI_FREQ") == 0) {
+        g_config.psi_freq = atoi(value);
+    } else if (strcmp(key, "LAUNCH_PARENTS") == 0) {
+        strncpy(g_config.launch_parents, value, sizeof(g_config.launch_parents) - 1);
+        g_config.launch_parents[sizeof(g_config.launch_parents) - 1] = '\0';
+    } else {
+        for (int c = 0; c < INPUT_CLASS_COUNT; c++) {
+            if (strcmp(key, g_class_policies[c].duration_key) == 0) {
+                g_class_policies[c].duration_ms = atoi(value);
+                return 0;
+            }
+        }
+        for (int r = 0; r < PSI_COUNT; r++) {
+            if (strcmp(key, g_psi[r].stall_key) == 0) {
+                g_config.psi_stall_us[r] = atoi(value);
+                return 0;
+            }
+        }
+        for (int g = 0; g < GESTURE_COUNT; g++) {
+            if (strcmp(key, g_gesture_levels[g].freq_key) == 0) {
+                g_gesture_levels[g].freq = atoi(value);
+                return 0;
+            }
+            if (strcmp(key, g_gesture_levels[g].duration_key) == 0) {
+                g_gesture_levels[g].duration_ms = atoi(value);
+                return 0;
+            }
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static void validate_config(void)
+{
+    if (g_config.duration_ms <= 0) g_config.duration_ms = 500;
+    if (g_config.cooldown_ms < 0) g_config.cooldown_ms = 100;
+    if (g_config.boost_freq < 0) g_config.boost_freq = 0;
+    if (g_config.boost_capacity < 0 || g_config.boost_capacity > CAPACITY_SCALE) g_config.boost_capacity = 0;
+    if (g_config.ramp_step_ms <= 0) g_config.ramp_step_ms = 50;
+    for (int c = 0; c < INPUT_CLASS_COUNT; c++) {
+        if (g_class_policies[c].duration_ms < 0)
+            g_class_policies[c].duration_ms = 0;
+    }
+    for (int g = 0; g < GESTURE_COUNT; g++) {
+        if (g_gesture_levels[g].freq < 0) g_gesture_levels[g].freq = 0;
+        if (g_gesture_levels[g].duration_ms < 0) g_gesture_levels[g].duration_ms = 0;
+    }
+    if (g_config.drag_slop <= 0) g_config.drag_slop = 2;
+    if (g_config.fling_velocity <= 0) g_config.fling_velocity = 150;
+    if (g_config.launch_duration_ms < 0) g_config.launch_duration_ms = 0;
+    if (g_config.launch_freq < 0) g_config.launch_freq = 0;
+    // The kernel accepts windows of 500ms to 10s
+    if (g_config.psi_window_us < 500000) g_config.psi_window_us = 500000;
+    if (g_config.psi_window_us > 10000000) g_config.psi_window_us = 10000000;
+    for (int r = 0; r < PSI_COUNT; r++) {
+        if (g_config.psi_stall_us[r] < 0 || g_config.psi_stall_us[r] > g_config.psi_window_us)
+            g_config.psi_stall_us[r] = 0;
+    }
+    if (g_config.psi_hold_ms <= 0) g_config.psi_hold_ms = 1000;
+    if (g_config.psi_freq < 0) g_config.psi_freq = 0;
+    if (g_config.thermal_trip < 0) g_config.thermal_trip = 0;
+    if (g_config.rt_priority < 1 || g_config.rt_priority > 99) g_config.rt_priority = 1;
+    if (g_config.thermal_poll_ms <= 0) g_config.thermal_poll_ms = 1000;
+}
+
+static const char *log_level_name(int level)
+{
+    return level == LOG_ERROR ? "error" : level == LOG_DEBUG ? "debug" : "info";
+}
+
+/* One KEY=value line, skipped when only names another key; returns lines written */
+__attribute__((format(printf, 4, 5)))
+static int config_line(FILE *fp, const char *only, const char *key, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (only && strcmp(only, key) != 0)
+        return 0;
+    fprintf(fp, "%s=", key);
+    va_start(ap, fmt);
+    vfprintf(fp, fmt, ap);
+    va_end(ap);
+    fputc('\n', fp);
+    return 1;
+}
+
+/* Appends to a list value built up for config_line() */
+__attribute__((format(printf, 3, 4)))
+static void list_add(char *buf, size_t size, const char *fmt, ...)
+{
+    size_t len = strlen(buf);
+    va_list ap;
+
+    if (len >= size)
+        return;
+    va_start(ap, fmt);
+    vsnprintf(buf + len, size - len, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * Effective configuration as config.conf lines; with only set, just that
+ * key. Returns how many lines were written, so 0 means an unknown key.
+ */
+static int write_config(FILE *fp, const char *only)
+{
+    char list[MAX_LINE];
+    int n = 0;
+
+    n += config_line(fp, only, "BOOST_BACKEND", "%s", g_config.backend == BACKEND_UCLAMP ? "uclamp" : "cpufreq");
+    n += config_line(fp, only, "BOOST_FREQ", "%d", g_config.boost_freq);
+    n += config_line(fp, only, "BOOST_CAPACITY", "%d", g_config.boost_capacity);
+    n += config_line(fp, only, "DURATION_MS", "%d", g_config.duration_ms);
+    n += config_line(fp, only, "COOLDOWN_MS", "%d", g_config.cooldown_ms);
+    n += config_line(fp, only, "TARGET_CPUS", "%s", g_config.target_cpus);
+    for (int i = 0; i < g_config.devfreq_count; i++)
+        n += config_line(fp, only, "DEVFREQ_BOOST", "%s %lu", g_config.devfreq_match[i], g_config.devfreq_floor[i]);
+    n += config_line(fp, only, "HOLD_WHILE_TOUCHING", "%d", g_config.hold_while_touching);
+    list[0] = '\0';
+    for (int i = 0; i < g_config.ramp_count; i++)
+        list_add(list, sizeof(list), "%s%d", i ? "," : "", g_config.ramp_steps[i]);
+    n += config_line(fp, only, "RAMP_STEPS", "%s", list);
+    n += config_line(fp, only, "RAMP_STEP_MS", "%d", g_config.ramp_step_ms);
+    n += config_line(fp, only, "DRAG_SLOP", "%d", g_config.drag_slop);
+    n += config_line(fp, only, "FLING_VELOCITY", "%d", g_config.fling_velocity);
+    for (int g = 0; g < GESTURE_COUNT; g++) {
+        n += config_line(fp, only, g_gesture_levels[g].freq_key, "%d", g_gesture_levels[g].freq);
+        n += config_line(fp, only, g_gesture_levels[g].duration_key, "%d", g_gesture_levels[g].duration_ms);
+    }
+    list[0] = '\0';
+    for (int c = 0, count = 0; c < INPUT_CLASS_COUNT; c++) {
+        if (g_class_policies[c].enabled)
+            list_add(list, sizeof(list), "%s%s", count++ ? "," : "", g_class_policies[c].name);
+    }
+    n += config_line(fp, only, "BOOST_CLASSES", "%s", list);
+    for (int c = 0; c < INPUT_CLASS_COUNT; c++)
+        n += config_line(fp, only, g_class_policies[c].duration_key, "%d", g_class_policies[c].duration_ms);
+    n += config_line(fp, only, "LAUNCH_DURATION_MS", "%d", g_config.launch_duration_ms);
+    n += config_line(fp, only, "LAUNCH_FREQ", "%d", g_config.launch_freq);
+    n += config_line(fp, only, "LAUNCH_PARENTS", "%s", g_config.launch_parents);
+    for (int r = 0; r < PSI_COUNT; r++)
+        n += config_line(fp, only, g_psi[r].stall_key, "%d", g_config.psi_stall_us[r]);
+    n += config_line(fp, only, "PSI_WINDOW_US", "%d", g_config.psi_window_us);
+    n += config_line(fp, only, "PSI_HOLD_MS", "%d", g_config.psi_hold_ms);
+    n += config_line(fp, only, "PSI_FREQ", "%d", g_config.psi_freq);
+    n += config_line(fp, only, "THERMAL_ZONES", "%s", g_config.thermal_zones);
+    list[0] = '\0';
+    for (int i = 0; i < g_config.thermal_count; i++)
+        list_add(list, sizeof(list), "%s%d:%d", i ? "," : "", g_config.thermal_temps[i], g_config.thermal_caps[i]);
+    n += config_line(fp, only, "THERMAL_CURVE", "%s", list);
+    n += config_line(fp, only, "THERMAL_TRIP", "%d", g_config.thermal_trip);
+    n += config_line(fp, only, "THERMAL_POLL_MS", "%d", g_config.thermal_poll_ms);
+    n += config_line(fp, only, "REALTIME", "%d", g_config.realtime);
+    n += config_line(fp, only, "RT_PRIORITY", "%d", g_config.rt_priority);
+    n += config_line(fp, only, "PIN_CPUS", "%s", g_config.pin_cpus);
+    n += config_line(fp, only, "USE_IO_URING", "%d", g_config.use_io_uring);
+    n += config_line(fp, only, "LOG_LEVEL", "%s", log_level_name(g_config.log_level));
+    n += config_line(fp, only, "ENABLED", "%d", g_config.enabled);
+    return n;
+}
+
+static void log_config(void)
+{
+    log_msg(LOG_INFO, "Config: BOOST_BACKEND=%s BOOST_FREQ=%d BOOST_CAPACITY=%d DURATION_MS=%d COOLDOWN_MS=%d TARGET_CPUS=%s",
+            g_config.backend == BACKEND_UCLAMP ? "uclamp" : "cpufreq", g_config.boost_freq, g_config.boost_capacity,
+            g_config.duration_ms, g_config.cooldown_ms, g_config.target_cpus);
+    log_msg(LOG_INFO, "Config: HOLD_WHILE_TOUCHING=%d RAMP_STEPS=%d steps RAMP_STEP_MS=%d",
+            g_config.hold_while_touching, g_config.ramp_count, g_config.ramp_step_ms);
+    for (int c = 0; c < INPUT_CLASS_COUNT; c++) {
+        const struct class_policy *cp = &g_class_policies[c];
+        log_msg(LOG_INFO, "Class %s: %s, %dms", cp->name, cp->enabled ? "boost" : "ignored",
+                cp->duration_ms ? cp->duration_ms : g_config.duration_ms);
+    }
+    for (int g = 0; g < GESTURE_COUNT; g++) {
+        const struct gesture_level *gl = &g_gesture_levels[g];
+        log_msg(LOG_INFO, "Gesture %s: FREQ=%d DURATION_MS=%d", gl->name,
+                gl->freq ? gl->freq : g_config.boost_freq, gl->duration_ms);
+    }
+    log_msg(LOG_INFO, "Config: DRAG_SLOP=%d%% FLING_VELOCITY=%d%%/s",
+            g_config.drag_slop, g_config.fling_velocity);
+    for (int i = 0; i < g_config.devfreq_count; i++)
+        log_msg(LOG_INFO, "Config: DEVFREQ_BOOST=%s %lu", g_config.devfreq_match[i], g_config.devfreq_floor[i]);
+    log_msg(LOG_INFO, "Config: LAUNCH_DURATION_MS=%d LAUNCH_FREQ=%d LAUNCH_PARENTS=%s",
+            g_config.launch_duration_ms, g_config.launch_freq ? g_config.launch_freq : g_config.boost_freq,
+            g_config.launch_parents);
+    log_msg(LOG_INFO, "Config: PSI_CPU_STALL_US=%d PSI_MEMORY_STALL_US=%d PSI_WINDOW_US=%d PSI_HOLD_MS=%d PSI_FREQ=%d",
+            g_config.psi_stall_us[PSI_CPU], g_config.psi_stall_us[PSI_MEMORY], g_config.psi_window_us,
+            g_config.psi_hold_ms, g_config.psi_freq ? g_config.psi_freq : g_config.boost_freq);
+    log_msg(LOG_INFO, "Config: REALTIME=%d RT_PRIORITY=%d PIN_CPUS=%s",
+            g_config.realtime, g_config.rt_priority, g_config.pin_cpus);
+    log_msg(LOG_INFO, "Config: THERMAL_ZONES=%s THERMAL_CURVE=%d steps THERMAL_TRIP=%d THERMAL_POLL_MS=%d",
+            g_config.thermal_zones, g_config.thermal_count, g_config.thermal_trip, g_config.thermal_poll_ms);
+}
+
+/*
+ * (Re)reads CONFIG_FILE on top of the built-in defaults, so a key removed
+ * from the file goes back to its default on reload.
+ */
 static void parse_config(void)
 {
+    static struct config default_config;
+    static struct class_policy default_classes[INPUT_CLASS_COUNT];
+    static struct gesture_level default_gestures[GESTURE_COUNT];
+    static int have_defaults;
+
+    if (!have_defaults) {
+        default_config = g_config;
+        memcpy(default_classes, g_class_policies, sizeof(default_classes));
+        memcpy(default_gestures, g_gesture_levels, sizeof(default_gestures));
+        have_defaults = 1;
+    } else {
+        g_config = default_config;
+        memcpy(g_class_policies, default_classes, sizeof(default_classes));
+        memcpy(g_gesture_levels, default_gestures, sizeof(default_gestures));
+    }
+
     FILE *fp = fopen(CONFIG_FILE, "r");
     if (!fp)
         return;
@@ -203,285 +975,2544 @@ static void parse_config(void)
         while (end > value && (*end == '\n' || *end == '\r' || *end == ' '))
             *end-- = '\0';
 
-        if (strcmp(key, "BOOST_FREQ") == 0) {
-            g_config.boost_freq = atoi(value);
-        } else if (strcmp(key, "DURATION_MS") == 0) {
-            g_config.duration_ms = atoi(value);
-        } else if (strcmp(key, "COOLDOWN_MS") == 0) {
-            g_config.cooldown_ms = atoi(value);
-        } else if (strcmp(key, "TARGET_CPUS") == 0) {
-            strncpy(g_config.target_cpus, value, sizeof(g_config.target_cpus) - 1);
-            g_config.target_cpus[sizeof(g_config.target_cpus) - 1] = '\0';
-        } else if (strcmp(key, "LOG_LEVEL") == 0) {
-            if (strcmp(value, "error") == 0 || strcmp(value, "0") == 0)
-                g_config.log_level = LOG_ERROR;
-            else if (strcmp(value, "info") == 0 || strcmp(value, "1") == 0)
-                g_config.log_level = LOG_INFO;
-            else if (strcmp(value, "debug") == 0 || strcmp(value, "2") == 0)
-                g_config.log_level = LOG_DEBUG;
-        } else if (strcmp(key, "ENABLED") == 0) {
-            g_config.enabled = atoi(value);
-        }
+        apply_config_key(key, value);
+    }
+
+    fclose(fp);
+
+    validate_config();
+    log_config();
+}
+
+static int test_bit(int bit, const unsigned long *bits)
+{
+    return (bits[bit / BITS_PER_LONG] >> (bit % BITS_PER_LONG)) & 1;
+}
+
+/*
+ * One pass of capability ioctls per node. Touch follows Android's reading of
+ * the same bits: absolute multitouch position (or single-touch position with
+ * BTN_TOUCH) is a screen unless the driver marks it INPUT_PROP_POINTER.
+ */
+static int classify_device(int fd)
+{
+    unsigned long ev[BITS_TO_LONGS(EV_CNT)] = {0};
+    unsigned long key[BITS_TO_LONGS(KEY_CNT)] = {0};
+    unsigned long abs[BITS_TO_LONGS(ABS_CNT)] = {0};
+    unsigned long rel[BITS_TO_LONGS(REL_CNT)] = {0};
+    unsigned long prop[BITS_TO_LONGS(INPUT_PROP_CNT)] = {0};
+
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(ev)), ev) < 0)
+        return INPUT_CLASS_NONE;
+    if (test_bit(EV_KEY, ev))
+        ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key)), key);
+    if (test_bit(EV_ABS, ev))
+        ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs)), abs);
+    if (test_bit(EV_REL, ev))
+        ioctl(fd, EVIOCGBIT(EV_REL, sizeof(rel)), rel);
+    ioctl(fd, EVIOCGPROP(sizeof(prop)), prop);
+
+    if (test_bit(BTN_GAMEPAD, key) || test_bit(BTN_JOYSTICK, key))
+        return INPUT_CLASS_GAMEPAD;
+
+    int mt = test_bit(ABS_MT_POSITION_X, abs) && test_bit(ABS_MT_POSITION_Y, abs);
+    int st = test_bit(ABS_X, abs) && test_bit(ABS_Y, abs);
+
+    if (!test_bit(INPUT_PROP_POINTER, prop)) {
+        if (mt || (st && test_bit(BTN_TOUCH, key) && !test_bit(BTN_TOOL_PEN, key)))
+            return INPUT_CLASS_TOUCH;
+        if (st && test_bit(BTN_TOOL_PEN, key))
+            return INPUT_CLASS_STYLUS;
+    }
+
+    // Wheels and crowns, but not mice
+    if (test_bit(EV_REL, ev) && !test_bit(REL_X, rel) &&
+        (test_bit(REL_WHEEL, rel) || test_bit(REL_HWHEEL, rel) || test_bit(REL_DIAL, rel)))
+        return INPUT_CLASS_ROTARY;
+
+    // Any real key below the button range, which covers power and volume
+    for (int k = KEY_ESC; k < BTN_MISC; k++) {
+        if (test_bit(k, key))
+            return INPUT_CLASS_KEYBOARD;
+    }
+
+    return INPUT_CLASS_NONE;
+}
+
+/* Returns N for "eventN", -1 for any other node */
+static int parse_event_node(const char *node)
+{
+    char *end;
+
+    if (strncmp(node, "event", 5) != 0)
+        return -1;
+
+    long num = strtol(node + 5, &end, 10);
+    if (end == node + 5 || *end != '\0' || num < 0)
+        return -1;
+    return num;
+}
+
+static int is_touch_class(int cls)
+{
+    return cls == INPUT_CLASS_TOUCH || cls == INPUT_CLASS_STYLUS;
+}
+
+/* Screen extents, so thresholds can be given as a share of the screen */
+static void touch_init(struct input_device *dev)
+{
+    struct input_absinfo ax, ay;
+
+    dev->mt = (ioctl(dev->fd, EVIOCGABS(ABS_MT_POSITION_X), &ax) == 0 &&
+               ioctl(dev->fd, EVIOCGABS(ABS_MT_POSITION_Y), &ay) == 0);
+    if (!dev->mt && (ioctl(dev->fd, EVIOCGABS(ABS_X), &ax) < 0 ||
+                     ioctl(dev->fd, EVIOCGABS(ABS_Y), &ay) < 0)) {
+        ax.minimum = ay.minimum = 0;
+        ax.maximum = ay.maximum = 1000;
+    }
+    dev->range_x = ax.maximum > ax.minimum ? ax.maximum - ax.minimum : 1000;
+    dev->range_y = ay.maximum > ay.minimum ? ay.maximum - ay.minimum : 1000;
+}
+
+/* Euclidean length within ~12%, without libm */
+static long approx_distance(long dx, long dy)
+{
+    if (dx < 0) dx = -dx;
+    if (dy < 0) dy = -dy;
+    return dx > dy ? dx + dy / 2 : dy + dx / 2;
+}
+
+/* Distance of the tracked contact from (x, y), in permille of the screen */
+static long touch_distance(const struct input_device *dev, int x, int y)
+{
+    return approx_distance((long)(dev->x - x) * 1000 / dev->range_x,
+                           (long)(dev->y - y) * 1000 / dev->range_y);
+}
+
+/* Per frame: velocity from the last movement, and tap -> drag past the slop */
+static void touch_track(struct input_device *dev, long long now_us)
+{
+    if (!dev->moved)
+        return;
+    dev->moved = 0;
+
+    if (dev->resample) {
+        dev->resample = 0;
+        if (dev->gesture == GESTURE_TAP) {
+            dev->start_x = dev->x;
+            dev->start_y = dev->y;
+        }
+    } else if (now_us > dev->last_move_us) {
+        long inst = touch_distance(dev, dev->last_x, dev->last_y) * 1000000 / (now_us - dev->last_move_us);
+        dev->velocity = (dev->velocity + inst) / 2;
+    }
+    dev->last_x = dev->x;
+    dev->last_y = dev->y;
+    dev->last_move_us = now_us;
+
+    if (dev->gesture < GESTURE_DRAG &&
+        touch_distance(dev, dev->start_x, dev->start_y) > g_config.drag_slop * 10)
+        dev->gesture = GESTURE_DRAG;
+}
+
+/* Reloads contact state from the kernel, at open and after SYN_DROPPED */
+static void touch_resync(struct input_device *dev)
+{
+    unsigned long key[BITS_TO_LONGS(KEY_CNT)] = {0};
+    struct input_absinfo slot;
+    struct {
+        __u32 code;
+        __s32 values[MAX_SLOTS];
+    } mt = { .code = ABS_MT_TRACKING_ID };
+
+    // The kernel only fills as many values as the device has slots
+    for (int i = 0; i < MAX_SLOTS; i++)
+        mt.values[i] = -1;
+
+    dev->contacts = 0;
+    if (ioctl(dev->fd, EVIOCGMTSLOTS(sizeof(mt)), &mt) == 0) {
+        for (int i = 0; i < MAX_SLOTS; i++) {
+            if (mt.values[i] >= 0)
+                dev->contacts |= 1ULL << i;
+        }
+    }
+    if (ioctl(dev->fd, EVIOCGABS(ABS_MT_SLOT), &slot) == 0)
+        dev->slot = slot.value;
+    if (ioctl(dev->fd, EVIOCGKEY(sizeof(key)), key) >= 0) {
+        dev->touching = test_bit(BTN_TOUCH, key);
+        dev->in_range = test_bit(BTN_TOOL_PEN, key);
+    }
+    dev->down = dev->contacts || dev->touching || dev->in_range;
+    dev->resample = 1;
+}
+
+/*
+ * Feeds one event to the device's touch state. Returns 1 at the end of a
+ * frame that belongs to a gesture, including the frame that lifts the last
+ * contact, so the boost covers the whole gesture plus the fling after it.
+ */
+static int touch_event(struct input_device *dev, const struct input_event *ie)
+{
+    if (dev->dropped) {
+        // Events up to the next SYN_REPORT are incomplete
+        if (ie->type != EV_SYN || ie->code != SYN_REPORT)
+            return 0;
+        dev->dropped = 0;
+        touch_resync(dev);
+        return dev->down;
+    }
+
+    switch (ie->type) {
+    case EV_ABS:
+        if (ie->code == (dev->mt ? ABS_MT_POSITION_X : ABS_X) ||
+            ie->code == (dev->mt ? ABS_MT_POSITION_Y : ABS_Y)) {
+            // A slot the contact mask cannot hold is never tracked
+            if (dev->mt && (dev->slot < 0 || dev->slot >= MAX_SLOTS))
+                return 0;
+            // Until a gesture starts, whichever contact reports first is tracked
+            if (!dev->down)
+                dev->track_slot = dev->slot;
+            if (dev->mt && dev->slot != dev->track_slot)
+                return 0;
+            if (ie->code == ABS_MT_POSITION_X || ie->code == ABS_X)
+                dev->x = ie->value;
+            else
+                dev->y = ie->value;
+            dev->moved = 1;
+        } else if (ie->code == ABS_MT_SLOT) {
+            dev->slot = ie->value;
+        } else if (ie->code == ABS_MT_TRACKING_ID && dev->slot >= 0 && dev->slot < MAX_SLOTS) {
+            if (ie->value >= 0)
+                dev->contacts |= 1ULL << dev->slot;
+            else
+                dev->contacts &= ~(1ULL << dev->slot);
+        }
+        return 0;
+    case EV_KEY:
+        if (ie->code == BTN_TOUCH)
+            dev->touching = (ie->value != 0);
+        else if (ie->code == BTN_TOOL_PEN)
+            dev->in_range = (ie->value != 0);
+        return 0;
+    case EV_SYN:
+        if (ie->code == SYN_DROPPED) {
+            dev->dropped = 1;
+            return 0;
+        }
+        if (ie->code == SYN_REPORT)
+            break;
+        return 0;
+    default:
+        return 0;
+    }
+
+    long long now_us = ie->input_event_sec * 1000000LL + ie->input_event_usec;
+    int was_down = dev->down;
+    dev->down = dev->contacts || dev->touching || dev->in_range;
+
+    // Follow another finger when the tracked one lifts; its position starts fresh
+    if (dev->mt && dev->contacts && !(dev->contacts & (1ULL << dev->track_slot))) {
+        dev->track_slot = __builtin_ctzll(dev->contacts);
+        dev->resample = 1;
+    }
+
+    if (dev->down && !was_down) {
+        dev->frames = 0;
+        dev->gesture = GESTURE_TAP;
+        dev->velocity = 0;
+        dev->start_x = dev->last_x = dev->x;
+        dev->start_y = dev->last_y = dev->y;
+        dev->last_move_us = now_us;
+        dev->moved = 0;
+        log_msg(LOG_DEBUG, "Gesture start on %s", dev->name);
+    } else if (dev->down) {
+        touch_track(dev, now_us);
+    } else if (was_down) {
+        // A finger that stopped before lifting did not fling
+        if (now_us - dev->last_move_us > FLING_WINDOW_US)
+            dev->velocity = 0;
+        if (dev->gesture == GESTURE_DRAG && dev->velocity >= g_config.fling_velocity * 10)
+            dev->gesture = GESTURE_FLING;
+        log_msg(LOG_DEBUG, "Gesture end on %s after %d frames: %s, %d%%/s", dev->name, dev->frames,
+                g_gesture_levels[dev->gesture].name, dev->velocity / 10);
+    }
+    if (dev->down)
+        dev->frames++;
+
+    return dev->down || was_down;
+}
+
+static struct input_device *find_device_by_fd(int fd)
+{
+    for (int i = 0; i < g_device_count; i++) {
+        if (g_devices[i].fd == fd)
+            return &g_devices[i];
+    }
+    return NULL;
+}
+
+static struct input_device *find_device_by_num(int num)
+{
+    for (int i = 0; i < g_device_count; i++) {
+        if (g_devices[i].num == num)
+            return &g_devices[i];
+    }
+    return NULL;
+}
+
+/* Starts monitoring /dev/input/<node> if it is an event node of a boosted class */
+static void add_input_device(const char *node)
+{
+    char path[MAX_PATH], name[64] = "unknown";
+    int num = parse_event_node(node);
+
+    if (num < 0 || find_device_by_num(num))
+        return;
+
+    if (g_device_count >= MAX_INPUT_DEVICES) {
+        log_msg(LOG_ERROR, "Too many input devices, ignoring %s", node);
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", INPUT_DEV_DIR, node);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        // ueventd may not have set permissions yet; IN_ATTRIB retries
+        log_msg(LOG_DEBUG, "Cannot open %s: %s", path, strerror(errno));
+        return;
+    }
+
+    ioctl(fd, EVIOCGNAME(sizeof(name)), name);
+    name[sizeof(name) - 1] = '\0';
+
+    int cls = classify_device(fd);
+    if (cls == INPUT_CLASS_NONE || !g_class_policies[cls].enabled) {
+        log_msg(LOG_DEBUG, "Ignoring %s (%s)", path, name);
+        close(fd);
+        return;
+    }
+
+    // Event timestamps on the same clock as ours, for latency accounting
+    int clk = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clk);
+
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.fd = fd
+    };
+    if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        log_msg(LOG_ERROR, "epoll_ctl %s failed: %s", path, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    struct input_device *dev = &g_devices[g_device_count++];
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = fd;
+    dev->num = num;
+    dev->cls = cls;
+    snprintf(dev->name, sizeof(dev->name), "%s", name);
+    if (is_touch_class(cls)) {
+        touch_init(dev);
+        touch_resync(dev);
+    }
+    log_msg(LOG_INFO, "Monitoring %s: %s (%s)", path, name, g_class_policies[cls].name);
+}
+
+static void remove_input_device(struct input_device *dev, const char *why)
+{
+    log_msg(LOG_INFO, "Input device event%d (%s) %s", dev->num, dev->name, why);
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, dev->fd, NULL);
+    close(dev->fd);
+    *dev = g_devices[--g_device_count];
+}
+
+static void scan_input_devices(void)
+{
+    DIR *dir = opendir(INPUT_DEV_DIR);
+    if (!dir) {
+        log_msg(LOG_ERROR, "Cannot open %s: %s", INPUT_DEV_DIR, strerror(errno));
+        return;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+        add_input_device(ent->d_name);
+
+    closedir(dir);
+}
+
+static int setup_inotify(void)
+{
+    g_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_inotify_fd < 0)
+        return -1;
+
+    g_input_wd = inotify_add_watch(g_inotify_fd, INPUT_DEV_DIR, IN_CREATE | IN_ATTRIB | IN_DELETE);
+    if (g_input_wd < 0) {
+        close(g_inotify_fd);
+        g_inotify_fd = -1;
+        return -1;
+    }
+
+    // The directory, not the file: editors often save by renaming over it
+    char dir[MAX_PATH];
+    snprintf(dir, sizeof(dir), "%s", CONFIG_FILE);
+    char *slash = strrchr(dir, '/');
+    if (slash)
+        *slash = '\0';
+    g_config_wd = inotify_add_watch(g_inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (g_config_wd < 0)
+        log_msg(LOG_INFO, "Cannot watch %s (%s), config reloads need SIGHUP", dir, strerror(errno));
+    return 0;
+}
+
+/* Keys that pick what to actuate; changing them needs re-detection */
+static int keep_restart_only(const struct config *old)
+{
+    int kept = 0;
+
+    if (strcmp(old->target_cpus, g_config.target_cpus) != 0) {
+        memcpy(g_config.target_cpus, old->target_cpus, sizeof(g_config.target_cpus));
+        log_msg(LOG_INFO, "TARGET_CPUS changes take effect after a restart");
+        kept++;
+    }
+    if (old->backend != g_config.backend) {
+        g_config.backend = old->backend;
+        log_msg(LOG_INFO, "BOOST_BACKEND changes take effect after a restart");
+        kept++;
+    }
+    if (strcmp(old->thermal_zones, g_config.thermal_zones) != 0) {
+        memcpy(g_config.thermal_zones, old->thermal_zones, sizeof(g_config.thermal_zones));
+        log_msg(LOG_INFO, "THERMAL_ZONES changes take effect after a restart");
+        kept++;
+    }
+    if (old->realtime != g_config.realtime || old->rt_priority != g_config.rt_priority ||
+        strcmp(old->pin_cpus, g_config.pin_cpus) != 0) {
+        g_config.realtime = old->realtime;
+        g_config.rt_priority = old->rt_priority;
+        memcpy(g_config.pin_cpus, old->pin_cpus, sizeof(g_config.pin_cpus));
+        log_msg(LOG_INFO, "REALTIME, RT_PRIORITY and PIN_CPUS changes take effect after a restart");
+        kept++;
+    }
+    if (old->use_io_uring != g_config.use_io_uring) {
+        g_config.use_io_uring = old->use_io_uring;
+        log_msg(LOG_INFO, "USE_IO_URING changes take effect after a restart");
+        kept++;
+    }
+    if (old->devfreq_count != g_config.devfreq_count ||
+        memcmp(old->devfreq_match, g_config.devfreq_match, sizeof(old->devfreq_match)) != 0 ||
+        memcmp(old->devfreq_floor, g_config.devfreq_floor, sizeof(old->devfreq_floor)) != 0) {
+        memcpy(g_config.devfreq_match, old->devfreq_match, sizeof(old->devfreq_match));
+        memcpy(g_config.devfreq_floor, old->devfreq_floor, sizeof(old->devfreq_floor));
+        g_config.devfreq_count = old->devfreq_count;
+        log_msg(LOG_INFO, "DEVFREQ_BOOST changes take effect after a restart");
+        kept++;
+    }
+    return kept;
+}
+
+static int proc_connector_op(enum proc_cn_mcast_op op)
+{
+    char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct nlmsghdr *nl = (struct nlmsghdr *)buf;
+    struct cn_msg *cn = NLMSG_DATA(nl);
+
+    memset(buf, 0, sizeof(buf));
+    nl->nlmsg_len = NLMSG_LENGTH(sizeof(*cn) + sizeof(op));
+    nl->nlmsg_type = NLMSG_DONE;
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(op);
+    memcpy(cn->data, &op, sizeof(op));
+
+    return send(g_proc_fd, buf, nl->nlmsg_len, 0) < 0 ? -1 : 0;
+}
+
+/* Process fork/exec/comm/exit events; needs CONFIG_PROC_EVENTS and root */
+static int setup_proc_connector(void)
+{
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = CN_IDX_PROC
+    };
+
+    g_proc_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (g_proc_fd < 0)
+        return -1;
+
+    if (bind(g_proc_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        proc_connector_op(PROC_CN_MCAST_LISTEN) < 0) {
+        close(g_proc_fd);
+        g_proc_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void close_proc_connector(void)
+{
+    proc_connector_op(PROC_CN_MCAST_IGNORE);
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, g_proc_fd, NULL);
+    close(g_proc_fd);
+    g_proc_fd = -1;
+}
+
+/*
+ * The connector wakes us for every fork on the system, so it is only open
+ * while LAUNCH_DURATION_MS is set. Called at startup and after each config
+ * change, which may also have changed LAUNCH_PARENTS.
+ */
+static void update_launch_listener(void)
+{
+    memset(g_parents, 0, sizeof(g_parents));
+
+    if (g_config.launch_duration_ms == 0) {
+        if (g_proc_fd >= 0) {
+            close_proc_connector();
+            log_msg(LOG_INFO, "Stopped watching app launches");
+        }
+        return;
+    }
+    if (g_proc_fd >= 0)
+        return;
+
+    if (setup_proc_connector() < 0) {
+        log_msg(LOG_INFO, "Proc connector unavailable (%s), no launch boost", strerror(errno));
+        return;
+    }
+
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.fd = g_proc_fd
+    };
+    if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_proc_fd, &ev) < 0) {
+        log_msg(LOG_ERROR, "epoll_ctl proc_fd failed: %s", strerror(errno));
+        close_proc_connector();
+        return;
+    }
+    log_msg(LOG_INFO, "Watching app launches");
+}
+
+static void close_psi_trigger(struct psi_trigger *t)
+{
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, t->fd, NULL);
+    close(t->fd);
+    t->fd = -1;
+}
+
+/*
+ * Arms "some <stall> <window>" on PSI_DIR/<resource>; the kernel then
+ * signals EPOLLPRI at most once per window. Triggers are re-armed only
+ * when their threshold or the window changed.
+ */
+static void update_psi_triggers(void)
+{
+    for (int r = 0; r < PSI_COUNT; r++) {
+        struct psi_trigger *t = &g_psi[r];
+        int stall_us = g_config.psi_stall_us[r];
+        char path[MAX_PATH], trigger[64];
+
+        if (t->fd >= 0) {
+            if (t->stall_us == stall_us && t->window_us == g_config.psi_window_us)
+                continue;
+            close_psi_trigger(t);
+        }
+        if (stall_us == 0)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s", PSI_DIR, t->name);
+        snprintf(trigger, sizeof(trigger), "some %d %d", stall_us, g_config.psi_window_us);
+        t->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        int armed = t->fd >= 0 && write(t->fd, trigger, strlen(trigger) + 1) >= 0;
+        if (!armed && t->fd >= 0 && errno == EINVAL) {
+            // Without CAP_SYS_RESOURCE the window must be a multiple of 2s
+            int window_us = (g_config.psi_window_us + 1999999) / 2000000 * 2000000;
+            snprintf(trigger, sizeof(trigger), "some %d %d", stall_us, window_us);
+            armed = write(t->fd, trigger, strlen(trigger) + 1) >= 0;
+        }
+        if (!armed) {
+            log_msg(LOG_INFO, "PSI trigger on %s unavailable: %s", path, strerror(errno));
+            if (t->fd >= 0)
+                close(t->fd);
+            t->fd = -1;
+            continue;
+        }
+
+        struct epoll_event ev = {
+            .events = EPOLLPRI,
+            .data.fd = t->fd
+        };
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, t->fd, &ev) < 0) {
+            log_msg(LOG_ERROR, "epoll_ctl psi_fd failed: %s", strerror(errno));
+            close(t->fd);
+            t->fd = -1;
+            continue;
+        }
+        t->stall_us = stall_us;
+        t->window_us = g_config.psi_window_us;
+        log_msg(LOG_INFO, "PSI trigger armed: %s %s", t->name, trigger);
+    }
+}
+
+/* Drops devices of classes no longer boosted and picks up newly enabled ones */
+static void apply_class_changes(void)
+{
+    for (int i = g_device_count - 1; i >= 0; i--) {
+        if (!g_class_policies[g_devices[i].cls].enabled)
+            remove_input_device(&g_devices[i], "no longer boosted");
+    }
+    scan_input_devices();
+}
+
+/*
+ * What a "max" boost writes per target policy. With BOOST_CAPACITY set it
+ * is the OPP with the lowest energy model cost among those whose capacity
+ * (cpu_capacity scaled by frequency) meets the target; without an energy
+ * model, the lowest such OPP. A policy that cannot reach the target, or
+ * BOOST_CAPACITY=0, gets max_freq.
+ */
+static void select_boost_opps(void)
+{
+    for (int p = 0; p < g_policy_count; p++) {
+        struct cpu_policy *policy = &g_policies[p];
+        int target = g_config.boost_capacity;
+        int freq = policy->max_freq;
+        int best = -1;
+
+        if (!policy->is_target)
+            continue;
+
+        for (int i = 0; target && i < policy->opp_count; i++) {
+            if ((long long)policy->capacity * policy->opps[i] < (long long)target * policy->max_freq)
+                continue;
+            if (best < 0 || (policy->opp_cost[i] && policy->opp_cost[i] < policy->opp_cost[best]))
+                best = i;
+            if (!policy->opp_cost[i])
+                break;
+        }
+        if (best >= 0)
+            freq = policy->opps[best];
+        else if (target && !policy->opp_count && target < policy->capacity)
+            freq = (int)((long long)policy->max_freq * target / policy->capacity);
+
+        if (freq != policy->boost_opp)
+            log_msg(LOG_INFO, "policy%d: boost to %d kHz (capacity %d of %d)", policy->policy_id, freq,
+                    (int)((long long)policy->capacity * freq / policy->max_freq), policy->capacity);
+        policy->boost_opp = freq;
+    }
+}
+
+/* Brings everything a reload or "set" may have changed in line with g_config */
+static void apply_config_changes(void)
+{
+    select_boost_opps();
+    apply_class_changes();
+    update_launch_listener();
+    update_psi_triggers();
+    g_thermal_checked_ms = 0;
+}
+
+/* Applies a new config.conf without touching the running boost */
+static void reload_config(const char *why)
+{
+    struct config old = g_config;
+
+    log_msg(LOG_INFO, "Reloading config (%s)", why);
+    parse_config();
+    keep_restart_only(&old);
+    apply_config_changes();
+
+    if (!g_config.enabled) {
+        log_msg(LOG_INFO, "Daemon disabled in config, exiting");
+        g_running = 0;
+    }
+}
+
+static void handle_inotify(void)
+{
+    char buf[INOTIFY_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    const char *config_name = strrchr(CONFIG_FILE, '/') ? strrchr(CONFIG_FILE, '/') + 1 : CONFIG_FILE;
+    int config_changed = 0;
+
+    while ((len = read(g_inotify_fd, buf, sizeof(buf))) > 0) {
+        const struct inotify_event *ie;
+
+        for (char *p = buf; p < buf + len; p += sizeof(*ie) + ie->len) {
+            ie = (const struct inotify_event *)p;
+            if (!ie->len)
+                continue;
+
+            if (ie->wd == g_config_wd) {
+                if (strcmp(ie->name, config_name) == 0)
+                    config_changed = 1;
+                continue;
+            }
+
+            if (ie->mask & (IN_CREATE | IN_ATTRIB)) {
+                add_input_device(ie->name);
+            } else if (ie->mask & IN_DELETE) {
+                struct input_device *dev = find_device_by_num(parse_event_node(ie->name));
+                if (dev)
+                    remove_input_device(dev, "removed");
+            }
+        }
+    }
+
+    // One reload for a burst of writes
+    if (config_changed)
+        reload_config("config.conf changed");
+}
+
+/* Parses sysfs CPU lists in either "0 1 2 3" or "0-3,6" form */
+static unsigned long long parse_cpu_list(const char *str)
+{
+    unsigned long long mask = 0;
+    const char *p = str;
+
+    while (*p) {
+        char *end;
+        long first, last;
+
+        if (*p < '0' || *p > '9') {
+            p++;
+            continue;
+        }
+
+        first = strtol(p, &end, 10);
+        last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last && cpu < MAX_CPUS; cpu++)
+            mask |= 1ULL << cpu;
+        p = end;
+    }
+
+    return mask;
+}
+
+static int policy_is_online(const struct cpu_policy *policy)
+{
+    return (policy->cpus & g_online_cpus) != 0;
+}
+
+static int compare_policies(const void *a, const void *b)
+{
+    return ((const struct cpu_policy *)a)->policy_id - ((const struct cpu_policy *)b)->policy_id;
+}
+
+static int read_ulong_file(const char *path, unsigned long *value)
+{
+    char buf[32];
+
+    if (read_string_file(path, buf, sizeof(buf)) < 0)
+        return -1;
+    *value = strtoul(buf, NULL, 10);
+    return 0;
+}
+
+/* scaling_available_frequencies; drivers without a frequency table have none */
+static void load_opps(struct cpu_policy *policy)
+{
+    char path[MAX_PATH], buf[MAX_LINE];
+    char *saveptr = NULL;
+
+    snprintf(path, sizeof(path), "%s/policy%d/scaling_available_frequencies",
+             CPUFREQ_SYSFS_DIR, policy->policy_id);
+    if (read_string_file(path, buf, sizeof(buf)) < 0)
+        return;
+
+    for (char *tok = strtok_r(buf, " ", &saveptr); tok; tok = strtok_r(NULL, " ", &saveptr)) {
+        int freq = atoi(tok);
+        int i = policy->opp_count;
+
+        if (freq <= 0 || i >= MAX_OPPS)
+            continue;
+        // Some drivers list frequencies in descending order
+        while (i > 0 && policy->opps[i - 1] > freq) {
+            policy->opps[i] = policy->opps[i - 1];
+            i--;
+        }
+        policy->opps[i] = freq;
+        policy->opp_count++;
+    }
+}
+
+/*
+ * Energy model cost per OPP, from debugfs: cpuN/ps:<freq>/cost on current
+ * kernels, pdN/cs:<freq>/cost on older ones. Costs stay 0 without one.
+ */
+static int load_energy_model(struct cpu_policy *policy)
+{
+    static const char *const layouts[][2] = { { "cpu", "ps:" }, { "pd", "cs:" } };
+    char path[MAX_PATH];
+    int found = 0;
+
+    for (int l = 0; l < 2 && !found; l++) {
+        for (int i = 0; i < policy->opp_count; i++) {
+            snprintf(path, sizeof(path), "%s/%s%d/%s%d/cost", ENERGY_MODEL_DIR,
+                     layouts[l][0], policy->first_cpu, layouts[l][1], policy->opps[i]);
+            if (read_ulong_file(path, &policy->opp_cost[i]) == 0)
+                found++;
+        }
+    }
+    return found;
+}
+
+/* Logged once at startup: what select_boost_opps() has to choose from */
+static void log_opp_table(const struct cpu_policy *policy, int has_em)
+{
+    char table[MAX_LINE / 2];
+    int len = 0;
+
+    table[0] = '\0';
+    for (int i = 0; i < policy->opp_count && len < (int)sizeof(table); i++)
+        len += snprintf(table + len, sizeof(table) - len, " %d", policy->opps[i]);
+
+    log_msg(LOG_INFO, "policy%d: capacity %d, %d OPPs%s:%s", policy->policy_id, policy->capacity,
+            policy->opp_count, has_em ? " with energy model" : "", policy->opp_count ? table : " none");
+}
+
+static int detect_cpus(void)
+{
+    int max_freq_global = 0;
+    int has_little = 0;
+    char path[MAX_PATH], buf[MAX_LINE];
+
+    DIR *dir = opendir(CPUFREQ_SYSFS_DIR);
+    if (!dir) {
+        log_msg(LOG_ERROR, "Cannot open %s: %s", CPUFREQ_SYSFS_DIR, strerror(errno));
+        return -1;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL && g_policy_count < MAX_POLICIES) {
+        if (strncmp(ent->d_name, "policy", 6) != 0)
+            continue;
+
+        struct cpu_policy *policy = &g_policies[g_policy_count];
+        memset(policy, 0, sizeof(*policy));
+        policy->policy_id = atoi(ent->d_name + 6);
+        snprintf(policy->label, sizeof(policy->label), "policy%d", policy->policy_id);
+        policy->min_fd = -1;
+        policy->max_fd = -1;
+
+        if (sysfs_attr_path(path, sizeof(path), CPUFREQ_SYSFS_DIR, ent->d_name, "related_cpus") < 0 ||
+            read_string_file(path, buf, sizeof(buf)) < 0)
+            continue;
+        policy->cpus = parse_cpu_list(buf);
+        if (!policy->cpus)
+            continue;
+        policy->first_cpu = __builtin_ctzll(policy->cpus);
+
+        if (sysfs_attr_path(path, sizeof(path), CPUFREQ_SYSFS_DIR, ent->d_name, "cpuinfo_max_freq") < 0 ||
+            read_int_file(path, &policy->max_freq) < 0)
+            continue;
+
+        if (sysfs_attr_path(path, sizeof(path), CPUFREQ_SYSFS_DIR, ent->d_name, "scaling_min_freq") == 0)
+            read_int_file(path, &policy->orig_min_freq);
+
+        if (policy->max_freq > max_freq_global)
+            max_freq_global = policy->max_freq;
+
+        if (policy->max_freq < BIG_LITTLE_THRESHOLD)
+            has_little = 1;
+
+        g_policy_count++;
+    }
+    closedir(dir);
+
+    if (g_policy_count == 0) {
+        log_msg(LOG_ERROR, "No cpufreq policies found");
+        return -1;
+    }
+
+    qsort(g_policies, g_policy_count, sizeof(g_policies[0]), compare_policies);
+
+    if (read_string_file(CPU_SYSFS_DIR "/online", buf, sizeof(buf)) == 0)
+        g_online_cpus = parse_cpu_list(buf);
+
+    int threshold = has_little ? BIG_LITTLE_THRESHOLD : 0;
+    for (int i = 0; i < g_policy_count; i++) {
+        g_policies[i].is_big = (g_policies[i].max_freq >= threshold);
+    }
+
+    if (strcmp(g_config.target_cpus, "all") == 0) {
+        for (int i = 0; i < g_policy_count; i++)
+            g_policies[i].is_target = 1;
+    } else if (strcmp(g_config.target_cpus, "big") == 0) {
+        for (int i = 0; i < g_policy_count; i++)
+            g_policies[i].is_target = g_policies[i].is_big;
+    } else if (strcmp(g_config.target_cpus, "little") == 0) {
+        for (int i = 0; i < g_policy_count; i++)
+            g_policies[i].is_target = !g_policies[i].is_big;
+    } else {
+        // A listed CPU selects the whole policy it belongs to
+        unsigned long long wanted = parse_cpu_list(g_config.target_cpus);
+        for (int i = 0; i < g_policy_count; i++)
+            g_policies[i].is_target = (g_policies[i].cpus & wanted) != 0;
+    }
+
+    int target_count = 0;
+    for (int i = 0; i < g_policy_count; i++) {
+        struct cpu_policy *policy = &g_policies[i];
+
+        if (!policy->is_target)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/policy%d/scaling_min_freq", CPUFREQ_SYSFS_DIR, policy->policy_id);
+        policy->min_fd = open(path, O_RDWR | O_CLOEXEC);
+        if (policy->min_fd < 0) {
+            log_msg(LOG_ERROR, "Cannot open %s: %s", path, strerror(errno));
+            policy->is_target = 0;
+            continue;
+        }
+
+        // Thermal throttling lowers scaling_max_freq; boosts are clamped to it
+        snprintf(path, sizeof(path), "%s/policy%d/scaling_max_freq", CPUFREQ_SYSFS_DIR, policy->policy_id);
+        policy->max_fd = open(path, O_RDONLY | O_CLOEXEC);
+        policy->limit_freq = policy->max_freq;
+
+        policy->capacity = CAPACITY_SCALE;
+        snprintf(path, sizeof(path), "%s/cpu%d/cpu_capacity", CPU_SYSFS_DIR, policy->first_cpu);
+        read_int_file(path, &policy->capacity);
+        load_opps(policy);
+        log_opp_table(policy, load_energy_model(policy));
+
+        log_msg(LOG_DEBUG, "Target policy%d: cpus=0x%llx max=%d orig_min=%d big=%d",
+                policy->policy_id, policy->cpus, policy->max_freq, policy->orig_min_freq, policy->is_big);
+        target_count++;
+    }
+
+    log_msg(LOG_INFO, "Detected %d cpufreq policies, %d targets (%s)",
+            g_policy_count, target_count, g_config.target_cpus);
+    return (target_count > 0) ? 0 : -1;
+}
+
+static void add_devfreq(const char *name, unsigned long floor)
+{
+    char path[MAX_PATH];
+    unsigned long max_freq;
+    struct devfreq_dev *df = &g_devfreqs[g_devfreq_count];
+
+    snprintf(path, sizeof(path), "%s/%s/max_freq", DEVFREQ_SYSFS_DIR, name);
+    if (read_ulong_file(path, &max_freq) < 0)
+        return;
+    snprintf(path, sizeof(path), "%s/%s/min_freq", DEVFREQ_SYSFS_DIR, name);
+    if (read_ulong_file(path, &df->orig_min_freq) < 0)
+        return;
+
+    // Older kernels reject a min_freq above max_freq
+    df->boost_freq = (floor == 0 || floor > max_freq) ? max_freq : floor;
+    if (df->boost_freq <= df->orig_min_freq) {
+        log_msg(LOG_INFO, "devfreq %s: floor %lu not above current min %lu, skipping",
+                name, df->boost_freq, df->orig_min_freq);
+        return;
+    }
+
+    df->min_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (df->min_fd < 0) {
+        log_msg(LOG_ERROR, "Cannot open %s: %s", path, strerror(errno));
+        return;
+    }
+
+    snprintf(df->name, sizeof(df->name), "%s", name);
+    g_devfreq_count++;
+    log_msg(LOG_INFO, "devfreq %s: min_freq %lu, boost %lu", name, df->orig_min_freq, df->boost_freq);
+}
+
+static void detect_devfreq(void)
+{
+    if (g_config.devfreq_count == 0)
+        return;
+
+    DIR *dir = opendir(DEVFREQ_SYSFS_DIR);
+    if (!dir) {
+        log_msg(LOG_ERROR, "Cannot open %s: %s", DEVFREQ_SYSFS_DIR, strerror(errno));
+        return;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL && g_devfreq_count < MAX_DEVFREQ) {
+        if (ent->d_name[0] == '.')
+            continue;
+
+        log_msg(LOG_DEBUG, "devfreq device: %s", ent->d_name);
+        for (int i = 0; i < g_config.devfreq_count; i++) {
+            if (strstr(ent->d_name, g_config.devfreq_match[i])) {
+                add_devfreq(ent->d_name, g_config.devfreq_floor[i]);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+}
+
+/* Zones whose type contains one of the THERMAL_ZONES substrings */
+static void detect_thermal_zones(void)
+{
+    DIR *dir = opendir(THERMAL_SYSFS_DIR);
+    struct dirent *ent;
+
+    if (!dir) {
+        log_msg(LOG_INFO, "Cannot open %s: %s, no thermal capping", THERMAL_SYSFS_DIR, strerror(errno));
+        return;
+    }
+
+    while ((ent = readdir(dir)) != NULL && g_zone_count < MAX_THERMAL_ZONES) {
+        struct thermal_zone *zone = &g_zones[g_zone_count];
+        char path[MAX_PATH], list[sizeof(g_config.thermal_zones)];
+        char *saveptr = NULL;
+        int match = 0;
+
+        if (strncmp(ent->d_name, "thermal_zone", 12) != 0)
+            continue;
+        if (sysfs_attr_path(path, sizeof(path), THERMAL_SYSFS_DIR, ent->d_name, "type") < 0 ||
+            read_string_file(path, zone->type, sizeof(zone->type)) < 0)
+            continue;
+
+        memcpy(list, g_config.thermal_zones, sizeof(list));
+        for (char *tok = strtok_r(list, ", ", &saveptr); tok && !match; tok = strtok_r(NULL, ", ", &saveptr))
+            match = strstr(zone->type, tok) != NULL;
+        if (!match)
+            continue;
+
+        if (sysfs_attr_path(path, sizeof(path), THERMAL_SYSFS_DIR, ent->d_name, "temp") < 0)
+            continue;
+        zone->fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (zone->fd < 0)
+            continue;
+        log_msg(LOG_DEBUG, "Thermal zone %s: %s", ent->d_name, zone->type);
+        g_zone_count++;
+    }
+    closedir(dir);
+
+    log_msg(LOG_INFO, "Watching %d thermal zones (%s)", g_zone_count, g_config.thermal_zones);
+}
+
+static int pread_int(int fd, int *value)
+{
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    *value = atoi(buf);
+    return 0;
+}
+
+/*
+ * Samples scaling_max_freq, and the zones when THERMAL_CURVE or
+ * THERMAL_TRIP is set, at most once per THERMAL_POLL_MS. It runs right
+ * after a boost is written, so an idle daemon never wakes for it and the
+ * boost never waits on it. Returns whether the cap on the boost changed.
+ */
+static int refresh_thermal(void)
+{
+    long long now = monotonic_ms();
+    int temp = 0, pct = 100, tripped, changed = 0;
+
+    if (g_thermal_checked_ms && now - g_thermal_checked_ms < g_config.thermal_poll_ms)
+        return 0;
+    g_thermal_checked_ms = now;
+
+    for (int i = 0; i < g_zone_count && (g_config.thermal_count || g_config.thermal_trip); i++) {
+        int t;
+        if (pread_int(g_zones[i].fd, &t) == 0 && t > temp)
+            temp = t;
+    }
+    for (int i = 0; i < g_config.thermal_count && g_zone_count; i++) {
+        if (temp >= g_config.thermal_temps[i])
+            pct = g_config.thermal_caps[i];
+    }
+    tripped = g_zone_count && g_config.thermal_trip && temp >= g_config.thermal_trip;
+
+    for (int i = 0; i < g_policy_count; i++) {
+        struct cpu_policy *policy = &g_policies[i];
+        int limit;
+
+        if (policy->max_fd < 0 || pread_int(policy->max_fd, &limit) < 0 || limit == policy->limit_freq)
+            continue;
+        log_msg(LOG_DEBUG, "policy%d: scaling_max_freq %d", policy->policy_id, limit);
+        policy->limit_freq = limit;
+        changed = 1;
+    }
+
+    if (pct != g_thermal_pct || tripped != g_thermal_tripped) {
+        log_msg(LOG_INFO, "Thermal: %d.%dC, %s", temp / 1000, (temp % 1000) / 100,
+                tripped ? "boost skipped" : pct < 100 ? "boost capped" : "boost uncapped");
+        g_thermal_pct = pct;
+        g_thermal_tripped = tripped;
+        changed = 1;
+    }
+    g_temp = temp;
+    return changed;
+}
+
+static void save_original_freqs(void)
+{
+    FILE *fp = fopen(ORIG_FREQ_FILE, "w");
+    if (!fp) {
+        log_msg(LOG_ERROR, "Cannot save original frequencies: %s", strerror(errno));
+        return;
+    }
+
+    // cpuN/cpufreq is the policy directory, so any member CPU addresses it
+    for (int i = 0; i < g_policy_count; i++) {
+        if (g_policies[i].is_target)
+            fprintf(fp, "%d:%d\n", g_policies[i].first_cpu, g_policies[i].orig_min_freq);
+    }
+    if (g_uclamp_fd >= 0)
+        fprintf(fp, "uclamp:%d\n", g_uclamp_orig);
+    // Name last: devfreq names may contain ':'
+    for (int i = 0; i < g_devfreq_count; i++)
+        fprintf(fp, "devfreq:%lu:%s\n", g_devfreqs[i].orig_min_freq, g_devfreqs[i].name);
+
+    fclose(fp);
+    log_msg(LOG_DEBUG, "Saved original frequencies");
+}
+
+/* Lowest OPP at or above freq; freq itself without a frequency table */
+static int opp_at_least(const struct cpu_policy *policy, int freq)
+{
+    for (int i = 0; i < policy->opp_count; i++) {
+        if (policy->opps[i] >= freq)
+            return policy->opps[i];
+    }
+    return policy->opp_count ? policy->opps[policy->opp_count - 1] : freq;
+}
+
+/* Highest OPP at or below freq; freq itself without a frequency table */
+static int opp_at_most(const struct cpu_policy *policy, int freq)
+{
+    for (int i = policy->opp_count - 1; i >= 0; i--) {
+        if (policy->opps[i] <= freq)
+            return policy->opps[i];
+    }
+    return policy->opp_count ? policy->opps[0] : freq;
+}
+
+/*
+ * The boost target on a real OPP: a kHz level is rounded up to one, and the
+ * result is held under THERMAL_CURVE and the current scaling_max_freq.
+ */
+static int policy_boost_freq(const struct cpu_policy *policy)
+{
+    int freq = (g_boost_khz == 0) ? policy->boost_opp : opp_at_least(policy, g_boost_khz);
+    int cap = (int)((long long)policy->max_freq * g_thermal_pct / 100);
+
+    if (policy->limit_freq > 0 && policy->limit_freq < cap)
+        cap = policy->limit_freq;
+    if (freq > cap)
+        freq = opp_at_most(policy, cap);
+    return freq > policy->orig_min_freq ? freq : policy->orig_min_freq;
+}
+
+/* pct% of the way from the original minimum up to the boost frequency */
+static int policy_ramp_freq(const struct cpu_policy *policy, int pct)
+{
+    int boost = policy_boost_freq(policy);
+
+    if (boost <= policy->orig_min_freq)
+        return policy->orig_min_freq;
+    return policy->orig_min_freq + (int)((long long)(boost - policy->orig_min_freq) * pct / 100);
+}
+
+/* What the policy should be running at right now: boost, a ramp step, or original */
+static int policy_current_freq(const struct cpu_policy *policy)
+{
+    if (g_boosted)
+        return policy_boost_freq(policy);
+    if (g_ramp_pct)
+        return policy_ramp_freq(policy, g_ramp_pct);
+    return policy->orig_min_freq;
+}
+
+static void log_write_error(const char *label, const char *what, int err)
+{
+    g_stats.write_failures++;
+    // An inactive policy rejects writes until a CPU comes back
+    log_msg(err == EBUSY ? LOG_DEBUG : LOG_ERROR, "Failed to %s %s: %s", what, label, strerror(err));
+}
+
+static void write_policy_freq(struct cpu_policy *policy, int freq, const char *what)
+{
+    if (pwrite_int(policy->min_fd, freq) < 0)
+        log_write_error(policy->label, what, errno);
+}
+
+static void uring_teardown(void)
+{
+    if (g_ring.sqes)
+        munmap(g_ring.sqes, g_ring.sqes_len);
+    if (g_ring.cq_ring && g_ring.cq_ring != g_ring.sq_ring)
+        munmap(g_ring.cq_ring, g_ring.cq_ring_len);
+    if (g_ring.sq_ring)
+        munmap(g_ring.sq_ring, g_ring.sq_ring_len);
+    if (g_ring.fd >= 0)
+        close(g_ring.fd);
+    memset(&g_ring, 0, sizeof(g_ring));
+    g_ring.fd = -1;
+}
+
+/*
+ * A bare io_uring (no liburing in the NDK) used to submit a whole boost or
+ * restore in one io_uring_enter(). WRITEV is used rather than WRITE since it
+ * exists on every kernel that has io_uring at all.
+ */
+static int uring_setup(void)
+{
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    g_ring.fd = syscall(__NR_io_uring_setup, MAX_WRITES, &params);
+    if (g_ring.fd < 0)
+        return -1;
+
+    g_ring.sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    g_ring.cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (g_ring.cq_ring_len > g_ring.sq_ring_len)
+            g_ring.sq_ring_len = g_ring.cq_ring_len;
+        g_ring.cq_ring_len = g_ring.sq_ring_len;
+    }
+
+    g_ring.sq_ring = mmap(NULL, g_ring.sq_ring_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, g_ring.fd, IORING_OFF_SQ_RING);
+    if (g_ring.sq_ring == MAP_FAILED) {
+        g_ring.sq_ring = NULL;
+        goto fail;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        g_ring.cq_ring = g_ring.sq_ring;
+    } else {
+        g_ring.cq_ring = mmap(NULL, g_ring.cq_ring_len, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, g_ring.fd, IORING_OFF_CQ_RING);
+        if (g_ring.cq_ring == MAP_FAILED) {
+            g_ring.cq_ring = NULL;
+            goto fail;
+        }
+    }
+
+    g_ring.sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    g_ring.sqes = mmap(NULL, g_ring.sqes_len, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, g_ring.fd, IORING_OFF_SQES);
+    if (g_ring.sqes == MAP_FAILED) {
+        g_ring.sqes = NULL;
+        goto fail;
+    }
+
+    char *sq = g_ring.sq_ring, *cq = g_ring.cq_ring;
+    g_ring.sq_head = (unsigned int *)(sq + params.sq_off.head);
+    g_ring.sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    g_ring.sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    g_ring.sq_array = (unsigned int *)(sq + params.sq_off.array);
+    g_ring.cq_head = (unsigned int *)(cq + params.cq_off.head);
+    g_ring.cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    g_ring.cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    g_ring.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+
+fail:
+    {
+        int err = errno;
+        uring_teardown();
+        errno = err;
+    }
+    return -1;
+}
+
+static void actuation_begin(void)
+{
+    g_write_count = 0;
+}
+
+static void actuation_add_str(int fd, const char *value, const char *label)
+{
+    if (fd < 0 || g_write_count >= MAX_WRITES)
+        return;
+
+    struct sysfs_write *w = &g_writes[g_write_count++];
+    w->fd = fd;
+    w->label = label;
+    w->iov.iov_base = w->buf;
+    w->iov.iov_len = snprintf(w->buf, sizeof(w->buf), "%s", value);
+}
+
+static void actuation_add(int fd, int value, const char *label)
+{
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%d", value);
+    actuation_add_str(fd, buf, label);
+}
+
+static void actuation_commit_serial(int first, const char *what)
+{
+    for (int i = first; i < g_write_count; i++) {
+        struct sysfs_write *w = &g_writes[i];
+
+        if (pwrite(w->fd, w->buf, w->iov.iov_len, 0) != (ssize_t)w->iov.iov_len)
+            log_write_error(w->label, what, errno);
+    }
+}
+
+/*
+ * Returns how many writes went through the ring, or -1 if the ring failed
+ * after some may have been submitted. The kernel stops at the first SQE it
+ * cannot take and does not wait in that case, so only the submitted ones
+ * are reaped; the caller writes the rest.
+ */
+static int actuation_commit_uring(const char *what)
+{
+    unsigned int tail = *g_ring.sq_tail;
+    unsigned int mask = *g_ring.sq_mask;
+
+    for (int i = 0; i < g_write_count; i++) {
+        unsigned int idx = (tail + i) & mask;
+        struct io_uring_sqe *sqe = &g_ring.sqes[idx];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = g_writes[i].fd;
+        sqe->addr = (unsigned long)&g_writes[i].iov;
+        sqe->len = 1;
+        sqe->off = 0;
+        sqe->user_data = i;
+        g_ring.sq_array[idx] = idx;
+    }
+    __atomic_store_n(g_ring.sq_tail, tail + g_write_count, __ATOMIC_RELEASE);
+
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, g_ring.fd, g_write_count, g_write_count,
+                      IORING_ENTER_GETEVENTS, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return -1;
+
+    // All submitted writes are waited for, so boost and restore never reorder
+    int submitted = ret;
+    int reaped = 0;
+    while (reaped < submitted) {
+        unsigned int head = *g_ring.cq_head;
+        unsigned int cq_tail = __atomic_load_n(g_ring.cq_tail, __ATOMIC_ACQUIRE);
+
+        if (head == cq_tail) {
+            do {
+                ret = syscall(__NR_io_uring_enter, g_ring.fd, 0, submitted - reaped,
+                              IORING_ENTER_GETEVENTS, NULL, 0);
+            } while (ret < 0 && errno == EINTR);
+            if (ret < 0)
+                return -1;
+            continue;
+        }
+
+        for (; head != cq_tail; head++, reaped++) {
+            struct io_uring_cqe *cqe = &g_ring.cqes[head & *g_ring.cq_mask];
+            struct sysfs_write *w = &g_writes[cqe->user_data];
+
+            if (cqe->res < 0)
+                log_write_error(w->label, what, -cqe->res);
+        }
+        __atomic_store_n(g_ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+    return submitted;
+}
+
+/*
+ * Issue everything queued since actuation_begin(). With io_uring the input
+ * thread makes one syscall per batch; kernfs has no nowait support, so the
+ * kernel runs the writes on its io-wq workers in parallel. If the ring
+ * stops working (seccomp or SELinux can deny io_uring_enter) or takes only
+ * part of the batch, whatever it did not write is done serially and the
+ * ring is dropped for good.
+ */
+static void actuation_commit(const char *what)
+{
+    int done = 0;
+
+    if (g_write_count == 0)
+        return;
+
+    if (g_ring.fd >= 0) {
+        done = actuation_commit_uring(what);
+        if (done == g_write_count)
+            return;
+        if (done < 0) {
+            log_msg(LOG_INFO, "io_uring actuation failed (%s), falling back to serial writes", strerror(errno));
+            done = 0;
+        } else {
+            log_msg(LOG_INFO, "io_uring took %d of %d writes, falling back to serial writes",
+                    done, g_write_count);
+        }
+        uring_teardown();
+    }
+    actuation_commit_serial(done, what);
+}
+
+/* cpu.uclamp.min is a percentage with two decimals, or "max" */
+static int parse_uclamp(const char *str)
+{
+    char *end;
+
+    if (strncmp(str, "max", 3) == 0)
+        return 10000;
+
+    long whole = strtol(str, &end, 10);
+    long frac = 0;
+    if (*end == '.') {
+        const char *p = end + 1;
+        for (int digits = 0; digits < 2; digits++) {
+            frac *= 10;
+            if (*p >= '0' && *p <= '9')
+                frac += *p++ - '0';
+        }
+    }
+    long value = whole * 100 + frac;
+    return value < 0 ? 0 : value > 10000 ? 10000 : value;
+}
+
+static int setup_uclamp(void)
+{
+    char buf[32];
+    ssize_t n;
+
+    g_uclamp_fd = open(UCLAMP_TOP_APP, O_RDWR | O_CLOEXEC);
+    if (g_uclamp_fd < 0)
+        return -1;
+
+    n = pread(g_uclamp_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        close(g_uclamp_fd);
+        g_uclamp_fd = -1;
+        return -1;
+    }
+    buf[n] = '\0';
+    g_uclamp_orig = parse_uclamp(buf);
+
+    // Boost frequencies are expressed against the fastest cluster
+    for (int i = 0; i < g_policy_count; i++) {
+        if (g_policies[i].max_freq > g_uclamp_max_khz)
+            g_uclamp_max_khz = g_policies[i].max_freq;
+    }
+
+    log_msg(LOG_INFO, "uclamp backend: %s = %d.%02d", UCLAMP_TOP_APP,
+            g_uclamp_orig / 100, g_uclamp_orig % 100);
+    return 0;
+}
+
+/*
+ * schedutil picks frequency in proportion to utilization, so a boost of
+ * N kHz becomes a uclamp.min of N over the fastest cluster's maximum.
+ */
+static int uclamp_current_value(void)
+{
+    int boost = 10000;
+
+    if (g_boost_khz && g_uclamp_max_khz && g_boost_khz < g_uclamp_max_khz)
+        boost = (int)((long long)g_boost_khz * 10000 / g_uclamp_max_khz);
+    // uclamp.min is a capacity request; the scheduler finds the OPP itself
+    if (!g_boost_khz && g_config.boost_capacity)
+        boost = g_config.boost_capacity * 10000 / CAPACITY_SCALE;
+    if (boost > g_thermal_pct * 100)
+        boost = g_thermal_pct * 100;
+    if (boost <= g_uclamp_orig)
+        return g_uclamp_orig;
+
+    if (g_boosted)
+        return boost;
+    if (g_ramp_pct)
+        return g_uclamp_orig + (boost - g_uclamp_orig) * g_ramp_pct / 100;
+    return g_uclamp_orig;
+}
+
+static unsigned long devfreq_current_freq(const struct devfreq_dev *df)
+{
+    if (g_boosted)
+        return df->boost_freq;
+    if (g_ramp_pct)
+        return df->orig_min_freq + (df->boost_freq - df->orig_min_freq) * g_ramp_pct / 100;
+    return df->orig_min_freq;
+}
+
+static void apply_current_freqs(const char *what)
+{
+    actuation_begin();
+    if (g_config.backend == BACKEND_UCLAMP) {
+        char buf[16];
+        int value = uclamp_current_value();
+
+        snprintf(buf, sizeof(buf), "%d.%02d", value / 100, value % 100);
+        actuation_add_str(g_uclamp_fd, buf, "top-app");
+    } else {
+        for (int i = 0; i < g_policy_count; i++) {
+            struct cpu_policy *policy = &g_policies[i];
+
+            if (!policy->is_target || !policy_is_online(policy))
+                continue;
+
+            actuation_add(policy->min_fd, policy_current_freq(policy), policy->label);
+        }
+    }
+
+    // Same batch as the CPU side, so memory and GPU floors move with it
+    for (int i = 0; i < g_devfreq_count; i++) {
+        char buf[24];
+
+        snprintf(buf, sizeof(buf), "%lu", devfreq_current_freq(&g_devfreqs[i]));
+        actuation_add_str(g_devfreqs[i].min_fd, buf, g_devfreqs[i].name);
+    }
+    actuation_commit(what);
+}
+
+static long diff_us(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000;
+}
+
+static void restore_original_freqs(void)
+{
+    if (g_stats.boost_began.tv_sec || g_stats.boost_began.tv_nsec) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        g_stats.boosted_us += diff_us(&g_stats.boost_began, &now);
+        g_stats.boost_began = (struct timespec){0, 0};
+    }
+
+    g_boosted = 0;
+    g_ramp_pct = 0;
+    g_ramp_step = 0;
+    apply_current_freqs("restore");
+    log_msg(LOG_DEBUG, "Restored original frequencies");
+}
+
+static void apply_boost(void)
+{
+    if (!g_stats.boost_began.tv_sec && !g_stats.boost_began.tv_nsec)
+        clock_gettime(CLOCK_MONOTONIC, &g_stats.boost_began);
+
+    g_boosted = 1;
+    g_ramp_pct = 0;
+    g_ramp_step = 0;
+    apply_current_freqs("boost");
+    log_msg(LOG_DEBUG, "Applied boost");
+}
+
+/* Steps down one RAMP_STEPS level; the next input boosts fully again */
+static void apply_ramp_step(void)
+{
+    g_boosted = 0;
+    g_ramp_pct = g_config.ramp_steps[g_ramp_step++];
+    apply_current_freqs("ramp");
+    log_msg(LOG_DEBUG, "Ramped down to %d%%", g_ramp_pct);
+}
+
+static int setup_uevent(void)
+{
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = 1
+    };
+
+    g_uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (g_uevent_fd < 0)
+        return -1;
+
+    if (bind(g_uevent_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(g_uevent_fd);
+        g_uevent_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * CPU hotplug arrives as ACTION=online/offline on /devices/system/cpu/cpuN.
+ * A policy that comes back is brought in line with the current boost state,
+ * since it may have gone down while boosted.
+ */
+static void handle_uevent(void)
+{
+    char buf[UEVENT_BUF_SIZE];
+    ssize_t len;
+
+    while ((len = recv(g_uevent_fd, buf, sizeof(buf) - 1, 0)) > 0) {
+        const char *action = NULL, *devpath = NULL;
+
+        buf[len] = '\0';
+        for (char *p = buf; p < buf + len; p += strlen(p) + 1) {
+            if (strncmp(p, "ACTION=", 7) == 0)
+                action = p + 7;
+            else if (strncmp(p, "DEVPATH=", 8) == 0)
+                devpath = p + 8;
+        }
+
+        if (!action || !devpath || strncmp(devpath, "/devices/system/cpu/cpu", 23) != 0)
+            continue;
+
+        int online = (strcmp(action, "online") == 0);
+        if (!online && strcmp(action, "offline") != 0)
+            continue;
+
+        char *end;
+        long cpu = strtol(devpath + 23, &end, 10);
+        if (end == devpath + 23 || *end != '\0' || cpu < 0 || cpu >= MAX_CPUS)
+            continue;
+
+        if (online)
+            g_online_cpus |= 1ULL << cpu;
+        else
+            g_online_cpus &= ~(1ULL << cpu);
+        log_msg(LOG_DEBUG, "cpu%ld %s", cpu, action);
+
+        if (!online)
+            continue;
+
+        for (int i = 0; i < g_policy_count; i++) {
+            struct cpu_policy *policy = &g_policies[i];
+
+            if (g_config.backend == BACKEND_CPUFREQ && policy->is_target && (policy->cpus & (1ULL << cpu)))
+                write_policy_freq(policy, policy_current_freq(policy), "resync");
+        }
+    }
+}
+
+static long elapsed_us(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return diff_us(since, &now);
+}
+
+static void hist_add(struct latency_hist *h, long us)
+{
+    int bucket = 0;
+
+    if (us < 0)
+        us = 0;
+    while (bucket < HIST_BUCKETS - 1 && (us >> (bucket + 1)))
+        bucket++;
+
+    h->buckets[bucket]++;
+    h->count++;
+    h->sum_us += us;
+    if (us > h->max_us)
+        h->max_us = us;
+}
+
+static void hist_dump(FILE *fp, const char *name, const struct latency_hist *h)
+{
+    fprintf(fp, "\n%s_us count=%llu avg=%llu max=%ld\n", name, h->count,
+            h->count ? h->sum_us / h->count : 0, h->max_us);
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (h->buckets[i])
+            fprintf(fp, "  %8lu-%-8lu %llu\n", i ? 1UL << i : 0UL, (1UL << (i + 1)) - 1, h->buckets[i]);
+    }
+}
+
+static void write_stats(FILE *fp)
+{
+    struct rusage usage;
+    struct timespec now, cpu;
+    long long boosted_us = g_stats.boosted_us;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    if (g_stats.boost_began.tv_sec || g_stats.boost_began.tv_nsec)
+        boosted_us += diff_us(&g_stats.boost_began, &now);
+
+    fprintf(fp, "uptime_s %ld\n", (long)(now.tv_sec - g_stats.started.tv_sec));
+    fprintf(fp, "cpu_time_ms %ld\n", (long)(cpu.tv_sec * 1000 + cpu.tv_nsec / 1000000));
+    fprintf(fp, "boosts %llu\n", g_stats.boosts);
+    fprintf(fp, "cooldown_suppressed %llu\n", g_stats.cooldown_suppressed);
+    fprintf(fp, "launches %llu\n", g_stats.launches);
+    fprintf(fp, "pressure_holds %llu\n", g_stats.pressure_holds);
+    fprintf(fp, "thermal_skipped %llu\n", g_stats.thermal_skipped);
+    fprintf(fp, "temp_mc %d\n", g_temp);
+    fprintf(fp, "sched %s\n", sched_getscheduler(0) == SCHED_FIFO ? "fifo" : "normal");
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        fprintf(fp, "page_faults %ld minor, %ld major\n", usage.ru_minflt, usage.ru_majflt);
+    fprintf(fp, "write_failures %llu\n", g_stats.write_failures);
+    fprintf(fp, "boosted_ms %lld\n", boosted_us / 1000);
+    fprintf(fp, "input_devices %d\n", g_device_count);
+    hist_dump(fp, "event_to_wakeup", &g_stats.event_to_wakeup);
+    hist_dump(fp, "wakeup_to_write", &g_stats.wakeup_to_write);
+    hist_dump(fp, "event_to_write", &g_stats.event_to_write);
+}
+
+static void dump_stats(void)
+{
+    FILE *fp = fopen(STATS_FILE, "w");
+    if (!fp) {
+        log_msg(LOG_ERROR, "Cannot write %s: %s", STATS_FILE, strerror(errno));
+        return;
+    }
+
+    write_stats(fp);
+    fclose(fp);
+    log_msg(LOG_DEBUG, "Wrote %s", STATS_FILE);
+}
+
+static int arm_timer(int timer_fd, int ms)
+{
+    struct itimerspec ts = {
+        .it_value = {
+            .tv_sec = ms / 1000,
+            .tv_nsec = (ms % 1000) * 1000000
+        },
+        .it_interval = {0, 0}
+    };
+
+    if (timerfd_settime(timer_fd, 0, &ts, NULL) < 0) {
+        log_msg(LOG_ERROR, "timerfd_settime failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int check_cooldown(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long elapsed_ms = (now.tv_sec - g_last_boost.tv_sec) * 1000 +
+                      (now.tv_nsec - g_last_boost.tv_nsec) / 1000000;
+
+    if (elapsed_ms < g_config.cooldown_ms)
+        return 0;
+
+    g_last_boost = now;
+    return 1;
+}
+
+static int any_contact_down(void)
+{
+    for (int i = 0; i < g_device_count; i++) {
+        if (is_touch_class(g_devices[i].cls) && g_devices[i].down)
+            return 1;
+    }
+    return 0;
+}
+
+/* Whether level a (kHz, 0 = max) is above level b */
+static int freq_above(int a, int b)
+{
+    if (a == b)
+        return 0;
+    return a == 0 || (b != 0 && a > b);
+}
+
+static int find_request(unsigned int id)
+{
+    for (int i = 0; i < g_request_count; i++) {
+        if (g_requests[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+static void remove_request(int idx)
+{
+    memmove(&g_requests[idx], &g_requests[idx + 1],
+            (g_request_count - idx - 1) * sizeof(g_requests[0]));
+    g_request_count--;
+}
+
+/*
+ * Keeps the table sorted by deadline. When it is full the lowest-priority
+ * client request makes room, but only for one that outranks it; the
+ * daemon's own input and launch requests always get a slot.
+ */
+static int insert_request(const struct boost_request *r)
+{
+    if (g_request_count == MAX_REQUESTS) {
+        int victim = -1;
+
+        for (int i = 0; i < g_request_count; i++) {
+            if (g_requests[i].id < FIRST_CLIENT_ID)
+                continue;
+            if (victim < 0 || g_requests[i].priority < g_requests[victim].priority)
+                victim = i;
+        }
+        if (victim < 0 || (r->id >= FIRST_CLIENT_ID && g_requests[victim].priority >= r->priority))
+            return -1;
+        log_msg(LOG_INFO, "Dropped boost request %u (%s) to make room for %s",
+                g_requests[victim].id, g_requests[victim].owner, r->owner);
+        remove_request(victim);
+    }
+
+    int i = g_request_count;
+    while (i > 0 && g_requests[i - 1].until_ms > r->until_ms) {
+        g_requests[i] = g_requests[i - 1];
+        i--;
+    }
+    g_requests[i] = *r;
+    g_request_count++;
+    return 0;
+}
+
+/*
+ * Writes the highest level any live request wants, if that is not what is
+ * already applied, and arms the timer for the earliest deadline. Above
+ * THERMAL_TRIP requests are still tracked but nothing is boosted. Returns
+ * whether a boost was written.
+ */
+static int update_level(void)
+{
+    int level = g_requests[0].freq;
+    int changed = 0;
+
+    for (int i = 1; i < g_request_count; i++) {
+        if (freq_above(g_requests[i].freq, level))
+            level = g_requests[i].freq;
+    }
+
+    if (g_thermal_tripped) {
+        g_stats.thermal_skipped++;
+        if (g_boosted || g_ramp_pct)
+            restore_original_freqs();
+    } else if (!g_boosted || level != g_boost_khz) {
+        g_boost_khz = level;
+        apply_boost();
+        changed = 1;
+    }
+
+    // Sampled after the write; only a cap that moved costs a second one
+    if (refresh_thermal()) {
+        if (g_thermal_tripped) {
+            if (g_boosted || g_ramp_pct) {
+                g_stats.thermal_skipped++;
+                restore_original_freqs();
+            }
+        } else {
+            g_boost_khz = level;
+            apply_boost();
+            changed = 1;
+        }
+    }
+
+    long long ms = g_requests[0].until_ms - monotonic_ms();
+    arm_timer(g_timer_fd, ms > 0 ? (int)ms : 1);
+    return changed;
+}
+
+/* Input and launch each keep one request, only raised or pushed out while it lives */
+static int source_request(unsigned int id, const char *owner, int freq, int ms)
+{
+    struct boost_request r = {
+        .id = id,
+        .freq = freq,
+        .until_ms = monotonic_ms() + ms
+    };
+    int idx = find_request(id);
+
+    snprintf(r.owner, sizeof(r.owner), "%s", owner);
+
+    if (idx >= 0) {
+        if (!freq_above(freq, g_requests[idx].freq))
+            r.freq = g_requests[idx].freq;
+        if (g_requests[idx].until_ms > r.until_ms)
+            r.until_ms = g_requests[idx].until_ms;
+        remove_request(idx);
+    }
+    insert_request(&r);
+    return update_level();
+}
+
+/* Fills in the id, queues r and applies the new level; -1 if there was no room */
+static int add_request(struct boost_request *r)
+{
+    r->id = g_next_request_id++;
+    if (g_next_request_id < FIRST_CLIENT_ID)
+        g_next_request_id = FIRST_CLIENT_ID;
+
+    if (insert_request(r) < 0)
+        return -1;
+    update_level();
+    return 0;
+}
+
+/* With HOLD_WHILE_TOUCHING a finger still down keeps the input request alive */
+static void expire_requests(void)
+{
+    long long now = monotonic_ms();
+
+    while (g_request_count && g_requests[0].until_ms <= now) {
+        struct boost_request r = g_requests[0];
+
+        remove_request(0);
+        if (r.id == INPUT_REQUEST_ID && g_config.hold_while_touching && any_contact_down()) {
+            r.until_ms = now + g_config.duration_ms;
+            insert_request(&r);
+            log_msg(LOG_DEBUG, "Holding boost, contact still down");
+        } else if (r.id >= FIRST_CLIENT_ID) {
+            log_msg(LOG_DEBUG, "Boost request %u (%s) expired", r.id, r.owner);
+        }
+    }
+}
+
+/*
+ * Re-levels while any request is left. After the last one the frequencies
+ * walk down RAMP_STEPS, one step per RAMP_STEP_MS, before the original
+ * minimum is written back.
+ */
+static void settle_requests(void)
+{
+    if (g_request_count) {
+        update_level();
+        return;
+    }
+
+    if (g_ramp_step < g_config.ramp_count && (g_boosted || g_ramp_pct)) {
+        apply_ramp_step();
+        arm_timer(g_timer_fd, g_config.ramp_step_ms);
+        return;
+    }
+
+    restore_original_freqs();
+}
+
+static void boost_timer_expired(void)
+{
+    expire_requests();
+    settle_requests();
+}
+
+static int event_wants_boost(int cls, const struct input_event *ie)
+{
+    switch (cls) {
+    case INPUT_CLASS_KEYBOARD:
+        return ie->type == EV_KEY && ie->value == 1;
+    case INPUT_CLASS_GAMEPAD:
+        return (ie->type == EV_KEY && ie->value == 1) || ie->type == EV_ABS;
+    case INPUT_CLASS_ROTARY:
+        return ie->type == EV_REL;
+    }
+    return 0;
+}
+
+static void trigger_boost(const struct input_device *dev, const struct input_event *ie)
+{
+    const struct class_policy *cp = &g_class_policies[dev->cls];
+    int freq = g_config.boost_freq;
+    int duration = cp->duration_ms ? cp->duration_ms : g_config.duration_ms;
+
+    if (is_touch_class(dev->cls)) {
+        const struct gesture_level *gl = &g_gesture_levels[dev->gesture];
+        if (gl->freq)
+            freq = gl->freq;
+        if (gl->duration_ms)
+            duration = gl->duration_ms;
+    }
+
+    if (!g_boosted && !check_cooldown()) {
+        g_stats.cooldown_suppressed++;
+        return;
+    }
+
+    // While boosted, input only pushes its deadline out unless it asks for more
+    if (!source_request(INPUT_REQUEST_ID, "input", freq, duration))
+        return;
+
+    // evdev stamps with CLOCK_MONOTONIC (EVIOCSCLOCKID), the same clock as ours
+    struct timespec event_ts = {
+        .tv_sec = ie->input_event_sec,
+        .tv_nsec = ie->input_event_usec * 1000L
+    };
+    struct timespec done;
+    clock_gettime(CLOCK_MONOTONIC, &done);
+
+    long to_wakeup = diff_us(&event_ts, &g_wakeup);
+    long to_write = diff_us(&g_wakeup, &done);
+    g_stats.boosts++;
+    hist_add(&g_stats.event_to_wakeup, to_wakeup);
+    hist_add(&g_stats.wakeup_to_write, to_write);
+    hist_add(&g_stats.event_to_write, to_wakeup + to_write);
+    log_msg(LOG_DEBUG, "Boost triggered by %s (%s%s%s): event-to-wakeup %ldus, wakeup-to-write %ldus",
+            dev->name, cp->name, is_touch_class(dev->cls) ? " " : "",
+            is_touch_class(dev->cls) ? g_gesture_levels[dev->gesture].name : "",
+            to_wakeup, to_write);
+}
+
+/*
+ * Drains the device in batches and makes one boost decision per wakeup,
+ * timed from the oldest event that asked for it.
+ */
+static void handle_input(struct input_device *dev)
+{
+    struct input_event batch[INPUT_BATCH];
+    struct input_event first;
+    int wants_boost = 0;
+    ssize_t n;
+
+    while ((n = read(dev->fd, batch, sizeof(batch))) > 0) {
+        int count = n / sizeof(batch[0]);
+
+        for (int i = 0; i < count; i++) {
+            int hit = is_touch_class(dev->cls) ? touch_event(dev, &batch[i])
+                                               : event_wants_boost(dev->cls, &batch[i]);
+            if (hit && !wants_boost) {
+                first = batch[i];
+                wants_boost = 1;
+            }
+        }
+
+        // A short read means the queue is empty; skip the EAGAIN round trip
+        if (n < (ssize_t)sizeof(batch))
+            break;
+    }
+
+    if (n < 0 && errno == ENODEV) {
+        remove_input_device(dev, "disconnected");
+        return;
+    }
+
+    if (wants_boost)
+        trigger_boost(dev, &first);
+}
+
+/* LAUNCH_PARENTS is a comma-separated list of process names */
+static int name_in_list(const char *name, const char *list)
+{
+    size_t len = strlen(name);
+
+    if (len == 0)
+        return 0;
+    for (const char *p = list + strspn(list, ", "); *p; p += strspn(p, ", ")) {
+        size_t n = strcspn(p, ", ");
+        if (n == len && strncmp(p, name, len) == 0)
+            return 1;
+        p += n;
     }
+    return 0;
+}
 
-    fclose(fp);
+/* Matches argv[0] without its directory; zygote renames itself to "zygote64" */
+static int is_launch_parent(pid_t pid)
+{
+    char path[64], cmdline[128];
+    ssize_t n;
+    int fd;
 
-    if (g_config.duration_ms <= 0) g_config.duration_ms = 500;
-    if (g_config.cooldown_ms < 0) g_config.cooldown_ms = 100;
-    if (g_config.boost_freq < 0) g_config.boost_freq = 0;
+    if (pid <= 0)
+        return 0;
+    for (int i = 0; i < PARENT_CACHE; i++) {
+        if (g_parents[i].pid == pid)
+            return g_parents[i].is_launcher;
+    }
 
-    log_msg(LOG_INFO, "Config: BOOST_FREQ=%d DURATION_MS=%d COOLDOWN_MS=%d TARGET_CPUS=%s",
-            g_config.boost_freq, g_config.duration_ms, g_config.cooldown_ms, g_config.target_cpus);
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    n = read(fd, cmdline, sizeof(cmdline) - 1);
+    close(fd);
+    if (n <= 0)
+        return 0;
+    cmdline[n] = '\0';
+
+    const char *name = strrchr(cmdline, '/');
+    struct proc_parent *entry = &g_parents[g_parent_next];
+    g_parent_next = (g_parent_next + 1) % PARENT_CACHE;
+    entry->pid = pid;
+    entry->is_launcher = name_in_list(name ? name + 1 : cmdline, g_config.launch_parents);
+    return entry->is_launcher;
 }
 
-static int find_touchscreen(char *device_path, size_t size)
+/* A pid that execs or exits is no longer what was cached for it */
+static void forget_parent(pid_t pid)
 {
-    DIR *dir = opendir("/sys/class/input");
-    if (!dir) {
-        log_msg(LOG_ERROR, "Cannot open /sys/class/input: %s", strerror(errno));
-        return -1;
+    for (int i = 0; i < PARENT_CACHE; i++) {
+        if (g_parents[i].pid == pid)
+            g_parents[i].pid = 0;
     }
+}
 
-    struct dirent *ent;
-    while ((ent = readdir(dir)) != NULL) {
-        if (strncmp(ent->d_name, "input", 5) != 0)
-            continue;
-
-        char name_path[MAX_PATH], name[128];
-        snprintf(name_path, sizeof(name_path), "/sys/class/input/%s/name", ent->d_name);
+static pid_t read_ppid(pid_t pid)
+{
+    char path[64], buf[512];
+    ssize_t n;
+    int fd, ppid;
 
-        if (read_string_file(name_path, name, sizeof(name)) < 0)
-            continue;
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
 
-        int is_touch = (strcasestr(name, "touch") != NULL ||
-                        strcasestr(name, "screen") != NULL ||
-                        strcasestr(name, "panel") != NULL ||
-                        strstr(name, "fts") != NULL ||
-                        strstr(name, "goodix") != NULL ||
-                        strstr(name, "synaptics") != NULL ||
-                        strstr(name, "atmel") != NULL ||
-                        strstr(name, "himax") != NULL ||
-                        strstr(name, "nvt") != NULL ||
-                        strstr(name, "ilitek") != NULL);
-
-        if (!is_touch)
-            continue;
+    // comm may contain spaces and parentheses; the state follows the last ')'
+    char *p = strrchr(buf, ')');
+    if (!p || sscanf(p + 1, " %*c %d", &ppid) != 1)
+        return -1;
+    return ppid;
+}
 
-        int input_num = atoi(ent->d_name + 5);
-        DIR *input_dir = opendir("/sys/class/input");
-        if (!input_dir)
-            continue;
+static void launch_boost(pid_t pid, const char *how)
+{
+    int freq = g_config.launch_freq ? g_config.launch_freq : g_config.boost_freq;
 
-        struct dirent *event_ent;
-        while ((event_ent = readdir(input_dir)) != NULL) {
-            if (strncmp(event_ent->d_name, "event", 5) != 0)
-                continue;
+    if (pid == g_last_launch)
+        return;
+    g_last_launch = pid;
+    g_stats.launches++;
+    source_request(LAUNCH_REQUEST_ID, "launch", freq, g_config.launch_duration_ms);
+    log_msg(LOG_DEBUG, "Launch boost for pid %d (%s)", pid, how);
+}
 
-            char link_path[MAX_PATH], real_path[MAX_PATH], input_real[MAX_PATH];
-            snprintf(link_path, sizeof(link_path), "/sys/class/input/%s/device", event_ent->d_name);
+/*
+ * Android apps are forked from zygote and never exec, so a new process
+ * whose parent is in LAUNCH_PARENTS is a cold start. A child taken from the
+ * prefork (USAP) pool was forked long before; it shows up when it renames
+ * itself for the app it turns into.
+ */
+static void handle_proc_events(void)
+{
+    char buf[PROC_CN_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    ssize_t len;
 
-            if (realpath(link_path, real_path) == NULL)
-                continue;
+    while ((len = recv(g_proc_fd, buf, sizeof(buf), 0)) > 0) {
+        for (struct nlmsghdr *nl = (struct nlmsghdr *)buf; NLMSG_OK(nl, len); nl = NLMSG_NEXT(nl, len)) {
+            struct cn_msg *cn = NLMSG_DATA(nl);
+            struct proc_event *ev = (struct proc_event *)cn->data;
 
-            snprintf(link_path, sizeof(link_path), "/sys/class/input/%s", ent->d_name);
-            if (realpath(link_path, input_real) == NULL)
+            if (nl->nlmsg_type != NLMSG_DONE || cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
                 continue;
 
-            if (strcmp(real_path, input_real) == 0) {
-                int event_num = atoi(event_ent->d_name + 5);
-                snprintf(device_path, size, "/dev/input/event%d", event_num);
-                closedir(input_dir);
-                closedir(dir);
-                log_msg(LOG_INFO, "Detected touchscreen: %s -> %s", name, device_path);
-                return 0;
+            switch (ev->what) {
+            case PROC_EVENT_FORK:
+                // Threads are forks too; only new processes count
+                if (ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid &&
+                    is_launch_parent(ev->event_data.fork.parent_tgid))
+                    launch_boost(ev->event_data.fork.child_pid, "fork");
+                break;
+            case PROC_EVENT_COMM:
+                if (ev->event_data.comm.process_pid == ev->event_data.comm.process_tgid &&
+                    is_launch_parent(read_ppid(ev->event_data.comm.process_pid)))
+                    launch_boost(ev->event_data.comm.process_pid, "renamed");
+                break;
+            case PROC_EVENT_EXEC:
+                forget_parent(ev->event_data.exec.process_tgid);
+                break;
+            case PROC_EVENT_EXIT:
+                forget_parent(ev->event_data.exit.process_tgid);
+                break;
+            default:
+                break;
             }
         }
-        closedir(input_dir);
-
-        snprintf(device_path, size, "/dev/input/event%d", input_num);
-        if (access(device_path, R_OK) == 0) {
-            closedir(dir);
-            log_msg(LOG_INFO, "Detected touchscreen (fallback): %s -> %s", name, device_path);
-            return 0;
-        }
     }
-
-    closedir(dir);
-    log_msg(LOG_ERROR, "No touchscreen found");
-    return -1;
 }
 
-static int detect_cpus(void)
+static struct psi_trigger *find_psi_trigger(int fd)
 {
-    int max_freq_global = 0;
-    int has_little = 0;
-
-    for (int i = 0; i < MAX_CPUS; i++) {
-        char path[MAX_PATH];
-        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+    for (int r = 0; r < PSI_COUNT; r++) {
+        if (g_psi[r].fd == fd)
+            return &g_psi[r];
+    }
+    return NULL;
+}
 
-        int max_freq;
-        if (read_int_file(path, &max_freq) < 0)
-            continue;
+/*
+ * Stalls only matter while an input or launch boost is live: the work the
+ * user waits on is starved, so the boost is held (and raised to PSI_FREQ)
+ * for PSI_HOLD_MS. A live pressure hold is not an interaction by itself,
+ * so sustained pressure cannot keep re-arming it; the last hold ends at
+ * most PSI_HOLD_MS after the input or launch boost.
+ */
+static void handle_psi(struct psi_trigger *t)
+{
+    int freq = g_config.psi_freq ? g_config.psi_freq : g_config.boost_freq;
 
-        g_cpus[g_cpu_count].cpu_id = i;
-        g_cpus[g_cpu_count].max_freq = max_freq;
-        g_cpus[g_cpu_count].is_online = 1;
-        g_cpus[g_cpu_count].is_target = 0;
+    if (find_request(INPUT_REQUEST_ID) < 0 && find_request(LAUNCH_REQUEST_ID) < 0) {
+        log_msg(LOG_DEBUG, "%s pressure outside an interaction, ignored", t->name);
+        return;
+    }
 
-        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq", i);
-        read_int_file(path, &g_cpus[g_cpu_count].orig_min_freq);
+    g_stats.pressure_holds++;
+    source_request(PRESSURE_REQUEST_ID, "pressure", freq, g_config.psi_hold_ms);
+    log_msg(LOG_DEBUG, "%s pressure, boost held for %dms", t->name, g_config.psi_hold_ms);
+}
 
-        if (max_freq > max_freq_global)
-            max_freq_global = max_freq;
+static socklen_t control_addr(struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path + 1, CONTROL_SOCKET, strlen(CONTROL_SOCKET));
+    return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(CONTROL_SOCKET);
+}
 
-        if (max_freq < BIG_LITTLE_THRESHOLD)
-            has_little = 1;
+static int setup_control(void)
+{
+    struct sockaddr_un addr;
+    socklen_t len = control_addr(&addr);
 
-        g_cpu_count++;
-    }
+    g_control_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (g_control_fd < 0)
+        return -1;
 
-    if (g_cpu_count == 0) {
-        log_msg(LOG_ERROR, "No CPUs with cpufreq support found");
+    if (bind(g_control_fd, (struct sockaddr *)&addr, len) < 0 || listen(g_control_fd, MAX_CLIENTS) < 0) {
+        close(g_control_fd);
+        g_control_fd = -1;
         return -1;
     }
+    return 0;
+}
 
-    int threshold = has_little ? BIG_LITTLE_THRESHOLD : 0;
-    for (int i = 0; i < g_cpu_count; i++) {
-        g_cpus[i].is_big = (g_cpus[i].max_freq >= threshold);
+static struct control_client *find_client(int fd)
+{
+    for (int i = 0; i < g_client_count; i++) {
+        if (g_clients[i].fd == fd)
+            return &g_clients[i];
     }
+    return NULL;
+}
 
-    if (strcmp(g_config.target_cpus, "all") == 0) {
-        for (int i = 0; i < g_cpu_count; i++)
-            g_cpus[i].is_target = 1;
-    } else if (strcmp(g_config.target_cpus, "big") == 0) {
-        for (int i = 0; i < g_cpu_count; i++)
-            g_cpus[i].is_target = g_cpus[i].is_big;
-    } else if (strcmp(g_config.target_cpus, "little") == 0) {
-        for (int i = 0; i < g_cpu_count; i++)
-            g_cpus[i].is_target = !g_cpus[i].is_big;
-    } else {
-        char buf[32];
-        strncpy(buf, g_config.target_cpus, sizeof(buf) - 1);
-        buf[sizeof(buf) - 1] = '\0';
-        char *saveptr;
-        char *tok = strtok_r(buf, ",", &saveptr);
-        while (tok) {
-            int cpu_id = atoi(tok);
-            for (int i = 0; i < g_cpu_count; i++) {
-                if (g_cpus[i].cpu_id == cpu_id)
-                    g_cpus[i].is_target = 1;
-            }
-            tok = strtok_r(NULL, ",", &saveptr);
+static void close_client(struct control_client *c)
+{
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    *c = g_clients[--g_client_count];
+}
+
+static int client_allowed(uid_t uid)
+{
+    int count = 0;
+
+    if (uid == 0)
+        return g_client_count < MAX_CLIENTS;
+    for (int i = 0; i < g_client_count; i++)
+        count += g_clients[i].uid == uid;
+    return g_client_count < MAX_CLIENTS - 1 && count < MAX_UID_CLIENTS;
+}
+
+/* Closes clients silent for CLIENT_IDLE_MS; returns ms until the next one is due, or -1 */
+static int expire_idle_clients(void)
+{
+    long long now = monotonic_ms();
+    int timeout = -1;
+
+    // Backwards, as close_client() moves the last client into the freed slot
+    for (int i = g_client_count - 1; i >= 0; i--) {
+        long long left = g_clients[i].last_active + CLIENT_IDLE_MS - now;
+
+        if (left <= 0) {
+            log_msg(LOG_DEBUG, "Dropping idle control client (uid %d)", (int)g_clients[i].uid);
+            close_client(&g_clients[i]);
+        } else if (timeout < 0 || left < timeout) {
+            timeout = left;
         }
     }
+    return timeout;
+}
 
-    int target_count = 0;
-    for (int i = 0; i < g_cpu_count; i++) {
-        if (g_cpus[i].is_target) {
-            log_msg(LOG_DEBUG, "Target CPU%d: max=%d orig_min=%d big=%d",
-                    g_cpus[i].cpu_id, g_cpus[i].max_freq, g_cpus[i].orig_min_freq, g_cpus[i].is_big);
-            target_count++;
+/*
+ * An abstract socket has no file permissions; any uid may connect and ask
+ * for boosts, changing settings is left to root (see run_command). Each
+ * non-root uid gets one connection and idle ones are dropped, so other apps
+ * cannot hold every slot and lock root out.
+ */
+static void handle_control_accept(void)
+{
+    int fd;
+
+    while ((fd = accept4(g_control_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || !client_allowed(cred.uid)) {
+            close(fd);
+            continue;
+        }
+
+        struct epoll_event ev = {
+            .events = EPOLLIN,
+            .data.fd = fd
+        };
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
         }
+        g_clients[g_client_count].fd = fd;
+        g_clients[g_client_count].uid = cred.uid;
+        g_clients[g_client_count].last_active = monotonic_ms();
+        g_clients[g_client_count].len = 0;
+        g_client_count++;
     }
+}
 
-    log_msg(LOG_INFO, "Detected %d CPUs, %d targets (%s)", g_cpu_count, target_count, g_config.target_cpus);
-    return (target_count > 0) ? 0 : -1;
+static void control_get(FILE *out, const char *key)
+{
+    if (write_config(out, key) == 0)
+        fprintf(out, "error: unknown key %s\n", key);
 }
 
-static void save_original_freqs(void)
+static void control_set(FILE *out, const char *key, char *value)
 {
-    FILE *fp = fopen(ORIG_FREQ_FILE, "w");
-    if (!fp) {
-        log_msg(LOG_ERROR, "Cannot save original frequencies: %s", strerror(errno));
+    struct config old = g_config;
+
+    if (apply_config_key(key, value) < 0) {
+        fprintf(out, "error: unknown key %s\n", key);
+        return;
+    }
+    validate_config();
+    if (keep_restart_only(&old)) {
+        fprintf(out, "error: %s needs a restart\n", key);
         return;
     }
+    apply_config_changes();
+    log_msg(LOG_INFO, "Control: set %s=%s", key, value);
+    fprintf(out, "ok\n");
 
-    for (int i = 0; i < g_cpu_count; i++) {
-        if (g_cpus[i].is_target)
-            fprintf(fp, "%d:%d\n", g_cpus[i].cpu_id, g_cpus[i].orig_min_freq);
+    if (!g_config.enabled) {
+        log_msg(LOG_INFO, "Daemon disabled via control socket, exiting");
+        g_running = 0;
     }
+}
 
-    fclose(fp);
-    log_msg(LOG_DEBUG, "Saved original frequencies");
+/* A whole decimal int and nothing after it; atoi() would take "100abc" */
+static int parse_int(const char *str, int *value)
+{
+    char *end;
+
+    errno = 0;
+    long v = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX)
+        return -1;
+    *value = (int)v;
+    return 0;
 }
 
-static void restore_original_freqs(void)
+static int uid_request_count(uid_t uid)
 {
-    for (int i = 0; i < g_cpu_count; i++) {
-        if (!g_cpus[i].is_target)
-            continue;
+    int count = 0;
+
+    for (int i = 0; i < g_request_count; i++) {
+        if (g_requests[i].id >= FIRST_CLIENT_ID && g_requests[i].uid == uid)
+            count++;
+    }
+    return count;
+}
 
-        char path[MAX_PATH];
-        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq",
-                 g_cpus[i].cpu_id);
+/*
+ * "request MS [LEVEL [PRIORITY [OWNER]]]": LEVEL is kHz or "max" and
+ * defaults to BOOST_FREQ. Non-root clients get at most MAX_REQUEST_MS,
+ * priority 0, no level above BOOST_FREQ and MAX_UID_REQUESTS live
+ * requests per uid.
+ */
+static void control_request(FILE *out, const struct control_client *c, const char *duration, char *rest)
+{
+    char *saveptr = NULL;
+    char *level = rest ? strtok_r(rest, " \t", &saveptr) : NULL;
+    char *priority = level ? strtok_r(NULL, " \t", &saveptr) : NULL;
+    char *owner = priority ? strtok_r(NULL, " \t", &saveptr) : NULL;
+    struct boost_request r = {
+        .uid = c->uid,
+        .freq = g_config.boost_freq
+    };
+    int ms;
 
-        if (write_int_file(path, g_cpus[i].orig_min_freq) < 0) {
-            log_msg(LOG_ERROR, "Failed to restore freq for cpu%d: %s",
-                    g_cpus[i].cpu_id, strerror(errno));
+    if (parse_int(duration, &ms) < 0 || ms <= 0 ||
+        (level && strcmp(level, "max") != 0 && (parse_int(level, &r.freq) < 0 || r.freq <= 0)) ||
+        (priority && parse_int(priority, &r.priority) < 0)) {
+        fprintf(out, "error: bad request\n");
+        return;
+    }
+    if (level && strcmp(level, "max") == 0)
+        r.freq = 0;
+    if (c->uid != 0) {
+        if (uid_request_count(c->uid) >= MAX_UID_REQUESTS) {
+            fprintf(out, "error: too many requests\n");
+            return;
         }
+        if (ms > MAX_REQUEST_MS)
+            ms = MAX_REQUEST_MS;
+        if (r.priority > 0)
+            r.priority = 0;
+        if (freq_above(r.freq, g_config.boost_freq))
+            r.freq = g_config.boost_freq;
     }
-    log_msg(LOG_DEBUG, "Restored original frequencies");
+    if (owner)
+        snprintf(r.owner, sizeof(r.owner), "%s", owner);
+    else
+        snprintf(r.owner, sizeof(r.owner), "uid%u", (unsigned)c->uid);
+    r.until_ms = monotonic_ms() + ms;
+
+    if (add_request(&r) < 0) {
+        fprintf(out, "error: too many requests\n");
+        return;
+    }
+    log_msg(LOG_DEBUG, "Boost request %u from %s: %dkHz for %dms, priority %d",
+            r.id, r.owner, r.freq, ms, r.priority);
+    fprintf(out, "ok %u\n", r.id);
 }
 
-static void apply_boost(void)
+static void control_cancel(FILE *out, const struct control_client *c, const char *id)
 {
-    for (int i = 0; i < g_cpu_count; i++) {
-        if (!g_cpus[i].is_target)
-            continue;
+    int idx = find_request(strtoul(id, NULL, 10));
 
-        char online_path[MAX_PATH];
-        snprintf(online_path, sizeof(online_path), "/sys/devices/system/cpu/cpu%d/online",
-                 g_cpus[i].cpu_id);
+    if (idx < 0 || g_requests[idx].id < FIRST_CLIENT_ID) {
+        fprintf(out, "error: no request %s\n", id);
+        return;
+    }
+    if (c->uid != 0 && g_requests[idx].uid != c->uid) {
+        fprintf(out, "error: permission denied\n");
+        return;
+    }
+    remove_request(idx);
+    settle_requests();
+    fprintf(out, "ok\n");
+}
 
-        int online = 1;
-        read_int_file(online_path, &online);
-        if (online == 0)
-            continue;
+static void write_requests(FILE *out)
+{
+    long long now = monotonic_ms();
+
+    for (int i = 0; i < g_request_count; i++) {
+        const struct boost_request *r = &g_requests[i];
+        char level[16];
+
+        if (r->freq)
+            snprintf(level, sizeof(level), "%d", r->freq);
+        else
+            snprintf(level, sizeof(level), "max");
+        fprintf(out, "%u %s priority=%d level=%s remaining=%lldms\n",
+                r->id, r->owner, r->priority, level, r->until_ms - now);
+    }
+}
 
-        int boost_freq = (g_config.boost_freq == 0) ? g_cpus[i].max_freq : g_config.boost_freq;
+/* One request line; replies are plain text and end with the client's EOF */
+static void run_command(const struct control_client *c, char *line)
+{
+    char *saveptr = NULL;
+    char *cmd = strtok_r(line, " \t\r", &saveptr);
+    char *arg = strtok_r(NULL, " \t\r", &saveptr);
+    char *rest = strtok_r(NULL, "\r", &saveptr);
 
-        char path[MAX_PATH];
-        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq",
-                 g_cpus[i].cpu_id);
+    if (!cmd)
+        return;
+    while (rest && (*rest == ' ' || *rest == '\t'))
+        rest++;
+
+    int out_fd = dup(c->fd);
+    FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+    if (!out) {
+        if (out_fd >= 0)
+            close(out_fd);
+        return;
+    }
 
-        if (write_int_file(path, boost_freq) < 0) {
-            log_msg(LOG_ERROR, "Failed to boost cpu%d: %s", g_cpus[i].cpu_id, strerror(errno));
+    if (c->uid != 0 && (strcmp(cmd, "set") == 0 || strcmp(cmd, "boost") == 0 ||
+                        strcmp(cmd, "reload") == 0)) {
+        fprintf(out, "error: permission denied\n");
+    } else if (strcmp(cmd, "stats") == 0) {
+        write_stats(out);
+    } else if (strcmp(cmd, "config") == 0) {
+        write_config(out, NULL);
+    } else if (strcmp(cmd, "get") == 0 && arg) {
+        control_get(out, arg);
+    } else if (strcmp(cmd, "set") == 0 && arg && rest) {
+        // Changes are not written back to config.conf
+        control_set(out, arg, rest);
+    } else if (strcmp(cmd, "request") == 0 && arg) {
+        control_request(out, c, arg, rest);
+    } else if (strcmp(cmd, "cancel") == 0 && arg) {
+        control_cancel(out, c, arg);
+    } else if (strcmp(cmd, "requests") == 0) {
+        write_requests(out);
+    } else if (strcmp(cmd, "boost") == 0) {
+        int ms = arg ? atoi(arg) : 0;
+        struct boost_request r = {
+            .freq = g_config.boost_freq,
+            .until_ms = monotonic_ms() + (ms > 0 ? ms : g_config.duration_ms),
+            .owner = "ctl"
+        };
+        if (add_request(&r) == 0) {
+            log_msg(LOG_INFO, "Control: forced boost for %dms", ms > 0 ? ms : g_config.duration_ms);
+            fprintf(out, "ok\n");
+        } else {
+            fprintf(out, "error: too many requests\n");
         }
+    } else if (strcmp(cmd, "reload") == 0) {
+        reload_config("control socket");
+        fprintf(out, "ok\n");
+    } else {
+        fprintf(out, "commands: stats | config | get KEY | set KEY VALUE | boost [MS] | reload\n"
+                     "          request MS [LEVEL [PRIORITY [OWNER]]] | cancel ID | requests\n");
     }
-    log_msg(LOG_DEBUG, "Applied boost");
+    fclose(out);
 }
 
-static int arm_timer(int timer_fd, int ms)
+static void handle_client(struct control_client *c)
 {
-    struct itimerspec ts = {
-        .it_value = {
-            .tv_sec = ms / 1000,
-            .tv_nsec = (ms % 1000) * 1000000
-        },
-        .it_interval = {0, 0}
-    };
+    ssize_t n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
 
-    if (timerfd_settime(timer_fd, 0, &ts, NULL) < 0) {
-        log_msg(LOG_ERROR, "timerfd_settime failed: %s", strerror(errno));
-        return -1;
+    if (n == 0 || (n < 0 && errno != EAGAIN)) {
+        close_client(c);
+        return;
+    }
+    if (n < 0)
+        return;
+
+    c->last_active = monotonic_ms();
+    c->len += n;
+    c->buf[c->len] = '\0';
+
+    char *line = c->buf, *nl;
+    while ((nl = strchr(line, '\n')) != NULL) {
+        *nl = '\0';
+        run_command(c, line);
+        line = nl + 1;
+    }
+
+    c->len -= line - c->buf;
+    memmove(c->buf, line, c->len);
+    if (c->len == (int)sizeof(c->buf) - 1) {
+        log_msg(LOG_ERROR, "Control request too long, dropping client");
+        close_client(c);
     }
-    return 0;
 }
 
-static int check_cooldown(void)
+/* "input_boost_daemon ctl <command...>": send one request and print the reply */
+static int control_client(int argc, char **argv)
 {
-    struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct sockaddr_un addr;
+    socklen_t addr_len = control_addr(&addr);
+    char req[CONTROL_BUF_SIZE] = "";
+    char buf[512];
+    ssize_t n;
+
+    for (int i = 0; i < argc; i++) {
+        strncat(req, argv[i], sizeof(req) - strlen(req) - 2);
+        strncat(req, i + 1 < argc ? " " : "\n", sizeof(req) - strlen(req) - 1);
+    }
 
-    long elapsed_ms = (now.tv_sec - g_last_boost.tv_sec) * 1000 +
-                      (now.tv_nsec - g_last_boost.tv_nsec) / 1000000;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        fprintf(stderr, "Cannot connect to daemon: %s\n", strerror(errno));
+        return 1;
+    }
 
-    if (elapsed_ms < g_config.cooldown_ms)
-        return 0;
+    if (write(fd, req, strlen(req)) != (ssize_t)strlen(req)) {
+        fprintf(stderr, "Cannot send request: %s\n", strerror(errno));
+        close(fd);
+        return 1;
+    }
+    shutdown(fd, SHUT_WR);
 
-    g_last_boost = now;
-    return 1;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        fwrite(buf, 1, n, stdout);
+    close(fd);
+    return 0;
 }
 
 static int check_singleton(void)
@@ -521,10 +3552,29 @@ static void recover_from_crash(void)
     if (!fp)
         return;
 
-    char line[64];
+    char line[MAX_LINE];
     while (fgets(line, sizeof(line), fp)) {
-        int cpu_id, freq;
-        if (sscanf(line, "%d:%d", &cpu_id, &freq) == 2) {
+        int cpu_id, freq, uclamp;
+        unsigned long df_freq;
+        char df_name[128];
+        if (sscanf(line, "devfreq:%lu:%127[^\n]", &df_freq, df_name) == 2) {
+            char path[MAX_PATH], buf[32];
+            snprintf(path, sizeof(path), "%s/%s/min_freq", DEVFREQ_SYSFS_DIR, df_name);
+            snprintf(buf, sizeof(buf), "%lu", df_freq);
+            int fd = open(path, O_WRONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                write(fd, buf, strlen(buf));
+                close(fd);
+            }
+        } else if (sscanf(line, "uclamp:%d", &uclamp) == 1) {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%d.%02d", uclamp / 100, uclamp % 100);
+            int fd = open(UCLAMP_TOP_APP, O_WRONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                write(fd, buf, strlen(buf));
+                close(fd);
+            }
+        } else if (sscanf(line, "%d:%d", &cpu_id, &freq) == 2) {
             char path[MAX_PATH];
             snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq", cpu_id);
             write_int_file(path, freq);
@@ -540,11 +3590,53 @@ static void cleanup(void)
     log_msg(LOG_INFO, "Shutting down...");
 
     restore_original_freqs();
+    dump_stats();
 
-    if (g_input_fd >= 0) {
-        close(g_input_fd);
-        g_input_fd = -1;
+    for (int i = 0; i < g_policy_count; i++) {
+        if (g_policies[i].min_fd >= 0) {
+            close(g_policies[i].min_fd);
+            g_policies[i].min_fd = -1;
+        }
+        if (g_policies[i].max_fd >= 0) {
+            close(g_policies[i].max_fd);
+            g_policies[i].max_fd = -1;
+        }
+    }
+    while (g_zone_count > 0)
+        close(g_zones[--g_zone_count].fd);
+    while (g_device_count > 0)
+        remove_input_device(&g_devices[g_device_count - 1], "closed");
+    if (g_inotify_fd >= 0) {
+        close(g_inotify_fd);
+        g_inotify_fd = -1;
+    }
+    while (g_client_count > 0)
+        close_client(&g_clients[g_client_count - 1]);
+    if (g_control_fd >= 0) {
+        close(g_control_fd);
+        g_control_fd = -1;
+    }
+    if (g_uevent_fd >= 0) {
+        close(g_uevent_fd);
+        g_uevent_fd = -1;
+    }
+    if (g_proc_fd >= 0)
+        close_proc_connector();
+    for (int r = 0; r < PSI_COUNT; r++) {
+        if (g_psi[r].fd >= 0)
+            close_psi_trigger(&g_psi[r]);
+    }
+    if (g_uclamp_fd >= 0) {
+        close(g_uclamp_fd);
+        g_uclamp_fd = -1;
+    }
+    for (int i = 0; i < g_devfreq_count; i++) {
+        if (g_devfreqs[i].min_fd >= 0) {
+            close(g_devfreqs[i].min_fd);
+            g_devfreqs[i].min_fd = -1;
+        }
     }
+    uring_teardown();
     if (g_timer_fd >= 0) {
         close(g_timer_fd);
         g_timer_fd = -1;
@@ -573,7 +3665,7 @@ static void cleanup(void)
     }
 }
 
-static int setup_epoll(const char *device_path)
+static int setup_epoll(void)
 {
     g_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (g_epoll_fd < 0) {
@@ -581,12 +3673,6 @@ static int setup_epoll(const char *device_path)
         return -1;
     }
 
-    g_input_fd = open(device_path, O_RDONLY | O_CLOEXEC);
-    if (g_input_fd < 0) {
-        log_msg(LOG_ERROR, "Cannot open %s: %s", device_path, strerror(errno));
-        return -1;
-    }
-
     g_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
     if (g_timer_fd < 0) {
         log_msg(LOG_ERROR, "timerfd_create failed: %s", strerror(errno));
@@ -615,13 +3701,6 @@ static int setup_epoll(const char *device_path)
 
     struct epoll_event ev;
 
-    ev.events = EPOLLIN;
-    ev.data.fd = g_input_fd;
-    if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_input_fd, &ev) < 0) {
-        log_msg(LOG_ERROR, "epoll_ctl input_fd failed: %s", strerror(errno));
-        return -1;
-    }
-
     ev.events = EPOLLIN;
     ev.data.fd = g_timer_fd;
     if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_timer_fd, &ev) < 0) {
@@ -636,20 +3715,130 @@ static int setup_epoll(const char *device_path)
         return -1;
     }
 
+    // Without hotplug events every policy is assumed online; writes to an
+    // inactive one just fail with EBUSY
+    if (setup_uevent() < 0) {
+        log_msg(LOG_INFO, "uevent socket unavailable (%s), not tracking CPU hotplug", strerror(errno));
+    } else {
+        ev.events = EPOLLIN;
+        ev.data.fd = g_uevent_fd;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_uevent_fd, &ev) < 0) {
+            log_msg(LOG_ERROR, "epoll_ctl uevent_fd failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    // Watch before scanning so a device appearing in between is not missed
+    if (setup_inotify() < 0) {
+        log_msg(LOG_INFO, "inotify unavailable (%s), not tracking input hotplug", strerror(errno));
+    } else {
+        ev.events = EPOLLIN;
+        ev.data.fd = g_inotify_fd;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_inotify_fd, &ev) < 0) {
+            log_msg(LOG_ERROR, "epoll_ctl inotify_fd failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    if (setup_control() < 0) {
+        log_msg(LOG_INFO, "Control socket unavailable (%s)", strerror(errno));
+    } else {
+        ev.events = EPOLLIN;
+        ev.data.fd = g_control_fd;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_control_fd, &ev) < 0) {
+            log_msg(LOG_ERROR, "epoll_ctl control_fd failed: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    update_launch_listener();
+    update_psi_triggers();
+
+    scan_input_devices();
+    if (g_device_count == 0) {
+        if (g_inotify_fd < 0) {
+            log_msg(LOG_ERROR, "No input devices to monitor");
+            return -1;
+        }
+        log_msg(LOG_INFO, "No input devices yet, waiting for hotplug");
+    }
+
     return 0;
 }
 
+/* Touches the stack the deepest handlers need, so it is resident before mlockall */
+static void prefault_stack(void)
+{
+    volatile char stack[PREFAULT_STACK];
+
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+/*
+ * REALTIME=1: SCHED_FIFO, so a loaded system cannot delay the epoll wakeup
+ * that starts a boost. RT tasks run at max frequency by default, so the
+ * daemon's own uclamp.min is held at 0 where the kernel allows it. Memory
+ * is locked with the stack prefaulted, leaving the boost path free of page
+ * faults; it already does no allocation or file opens.
+ */
+static void enter_low_latency_mode(void)
+{
+    if (!g_config.realtime)
+        return;
+
+    if (g_config.pin_cpus[0]) {
+        unsigned long long cpus = parse_cpu_list(g_config.pin_cpus);
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (cpus & (1ULL << cpu))
+                CPU_SET(cpu, &set);
+        }
+        if (!cpus || sched_setaffinity(0, sizeof(set), &set) < 0)
+            log_msg(LOG_ERROR, "Cannot pin to CPUs %s: %s", g_config.pin_cpus, strerror(errno));
+        else
+            log_msg(LOG_INFO, "Pinned to CPUs %s", g_config.pin_cpus);
+    }
+
+    struct sched_attr_uclamp attr = {
+        .size = sizeof(attr),
+        .sched_policy = SCHED_FIFO,
+        .sched_flags = SCHED_FLAG_UTIL_CLAMP_MIN,
+        .sched_priority = g_config.rt_priority,
+        .sched_util_min = 0
+    };
+    struct sched_param param = { .sched_priority = g_config.rt_priority };
+
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) == 0) {
+        log_msg(LOG_INFO, "Running SCHED_FIFO priority %d, uclamp.min 0", g_config.rt_priority);
+    } else if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+        // No CONFIG_UCLAMP_TASK
+        log_msg(LOG_INFO, "Running SCHED_FIFO priority %d", g_config.rt_priority);
+    } else {
+        log_msg(LOG_ERROR, "Cannot set SCHED_FIFO: %s, using nice -20", strerror(errno));
+        setpriority(PRIO_PROCESS, 0, -20);
+    }
+
+    prefault_stack();
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+        log_msg(LOG_ERROR, "mlockall failed: %s", strerror(errno));
+    else
+        log_msg(LOG_INFO, "Memory locked");
+}
+
 static void event_loop(void)
 {
     struct epoll_event events[MAX_EVENTS];
-    struct input_event ie;
     struct signalfd_siginfo siginfo;
     uint64_t timer_exp;
 
     log_msg(LOG_INFO, "Entering event loop");
 
     while (g_running) {
-        int n = epoll_wait(g_epoll_fd, events, MAX_EVENTS, -1);
+        int n = epoll_wait(g_epoll_fd, events, MAX_EVENTS, expire_idle_clients());
+        clock_gettime(CLOCK_MONOTONIC, &g_wakeup);
         if (n < 0) {
             if (errno == EINTR)
                 continue;
@@ -659,36 +3848,39 @@ static void event_loop(void)
 
         for (int i = 0; i < n; i++) {
             int fd = events[i].data.fd;
-
-            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
-                if (fd == g_input_fd) {
-                    log_msg(LOG_ERROR, "Input device disconnected, exiting");
-                    g_running = 0;
-                    break;
-                }
-            }
-
-            if (fd == g_input_fd) {
-                while (read(g_input_fd, &ie, sizeof(ie)) == sizeof(ie)) {
-                    if (ie.type == EV_ABS || ie.type == EV_SYN) {
-                        if (check_cooldown()) {
-                            apply_boost();
-                            arm_timer(g_timer_fd, g_config.duration_ms);
-                            log_msg(LOG_DEBUG, "Boost triggered");
-                        }
-                        break;
-                    }
-                }
+            struct input_device *dev = find_device_by_fd(fd);
+
+            if (dev) {
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    remove_input_device(dev, "disconnected");
+                else
+                    handle_input(dev);
+            } else if (fd == g_inotify_fd) {
+                handle_inotify();
+            } else if (fd == g_control_fd) {
+                handle_control_accept();
+            } else if (find_client(fd)) {
+                handle_client(find_client(fd));
             } else if (fd == g_timer_fd) {
                 if (read(g_timer_fd, &timer_exp, sizeof(timer_exp)) == sizeof(timer_exp)) {
-                    restore_original_freqs();
+                    boost_timer_expired();
                 }
+            } else if (fd == g_uevent_fd) {
+                handle_uevent();
+            } else if (fd == g_proc_fd) {
+                handle_proc_events();
+            } else if (find_psi_trigger(fd)) {
+                handle_psi(find_psi_trigger(fd));
             } else if (fd == g_signal_fd) {
                 if (read(g_signal_fd, &siginfo, sizeof(siginfo)) == sizeof(siginfo)) {
                     int sig = siginfo.ssi_signo;
-                    if (sig == SIGTERM || sig == SIGINT || sig == SIGHUP) {
+                    if (sig == SIGHUP) {
+                        reload_config("SIGHUP");
+                    } else if (sig == SIGTERM || sig == SIGINT) {
                         log_msg(LOG_INFO, "Received signal %d, shutting down", sig);
                         g_running = 0;
+                    } else if (sig == SIGUSR1) {
+                        dump_stats();
                     } else {
                         log_msg(LOG_DEBUG, "Ignoring signal %d", sig);
                     }
@@ -698,8 +3890,13 @@ static void event_loop(void)
     }
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
+    if (argc > 2 && strcmp(argv[1], "ctl") == 0)
+        return control_client(argc - 2, argv + 2);
+
+    clock_gettime(CLOCK_MONOTONIC, &g_stats.started);
+
     g_log_fd = open(LOG_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
     if (g_log_fd < 0) {
         fprintf(stderr, "Cannot open log file: %s\n", strerror(errno));
@@ -722,36 +3919,38 @@ int main(void)
         return 0;
     }
 
-    char device_path[MAX_PATH];
-    int retry;
-    for (retry = 0; retry < 6; retry++) {
-        if (find_touchscreen(device_path, sizeof(device_path)) == 0)
-            break;
-        log_msg(LOG_INFO, "No touchscreen found, retrying in 30s (%d/6)", retry + 1);
-        sleep(30);
-    }
-
-    if (retry >= 6) {
-        log_msg(LOG_ERROR, "Failed to detect touchscreen after retries, exiting");
-        unlink(PID_FILE);
-        close(g_log_fd);
-        return 1;
-    }
-
     if (detect_cpus() < 0) {
         log_msg(LOG_ERROR, "Failed to detect target CPUs, exiting");
         unlink(PID_FILE);
         close(g_log_fd);
         return 1;
     }
+    select_boost_opps();
+
+    if (g_config.backend == BACKEND_UCLAMP && setup_uclamp() < 0) {
+        log_msg(LOG_ERROR, "Cannot use %s (%s), falling back to cpufreq", UCLAMP_TOP_APP, strerror(errno));
+        g_config.backend = BACKEND_CPUFREQ;
+    }
+    detect_devfreq();
+    detect_thermal_zones();
 
     save_original_freqs();
 
-    if (setup_epoll(device_path) < 0) {
+    if (g_config.use_io_uring) {
+        if (uring_setup() == 0)
+            log_msg(LOG_INFO, "Using io_uring for sysfs actuation");
+        else
+            log_msg(LOG_INFO, "io_uring unavailable (%s), using serial writes", strerror(errno));
+    }
+
+    if (setup_epoll() < 0) {
         log_msg(LOG_ERROR, "Failed to setup epoll, exiting");
         cleanup();
         return 1;
     }
+    enter_low_latency_mode();
+    log_msg(LOG_INFO, "Ready in %ldms, monitoring %d input devices",
+            elapsed_us(&g_stats.started) / 1000, g_device_count);
 
     event_loop();
     cleanup();
@@ -2,7 +2,8 @@
 # fix-susfs-safety.sh
 # Applies security and correctness fixes to upstream SUSFS source:
 # - strncpy null-termination (10+ locations)
-# - Spin lock race conditions in kstat/open_redirect hash lookups
+# - Spin lock race conditions in open_redirect hash lookups
+# - RCU readers for the sus_kstat hash table
 # - NULL deref in cmdline_or_bootconfig and enabled_features (deref after failed kzalloc)
 # - Remove unused fsnotify_backend.h include
 # - Change sus_mount default from false to true
@@ -184,13 +185,15 @@ if ! grep -B2 'hash_for_each_safe(SUS_KSTAT_HLIST' "$SUSFS_C" | grep -q 'spin_lo
         getline add_line
         getline unlock_line
         print "\t\t\tspin_lock(&susfs_spin_lock_sus_kstat);"
-        print "\t\t\thash_del(&tmp_entry->node);"
+        print "\t\t\thash_del_rcu(&tmp_entry->node);"
         # extract hash_add line content (strip leading whitespace, reindent)
         gsub(/^[\t ]+/, "", add_line)
+        sub(/hash_add\(/, "hash_add_rcu(", add_line)
         print "\t\t\t" add_line
         print "\t\t\tspin_unlock(&susfs_spin_lock_sus_kstat);"
-        # kfree after unlock
+        # kfree after unlock, once RCU readers are done with the old entry
         gsub(/^[\t ]+/, "", kfree_line)
+        print "\t\t\tsynchronize_rcu();"
         print "\t\t\t" kfree_line
         next
     }
@@ -205,30 +208,34 @@ if ! grep -B2 'hash_for_each_safe(SUS_KSTAT_HLIST' "$SUSFS_C" | grep -q 'spin_lo
     ((fix_count++)) || true
 fi
 
-# 4b. susfs_sus_ino_for_generic_fillattr: wrap with irqsave
-if ! grep -B2 'hash_for_each_possible(SUS_KSTAT_HLIST, entry, node, ino)' "$SUSFS_C" | head -1 | grep -q 'spin_lock_irqsave'; then
-    echo "[+] Fixing spin lock race in susfs_sus_ino_for_generic_fillattr"
-    # Add unsigned long flags; variable and spin_lock_irqsave before hash lookup
+# 4b. susfs_sus_ino_for_generic_fillattr: RCU reader
+# Runs on every stat() of a flagged inode; readers must not serialize on the
+# writer lock. Writers publish with hash_add_rcu/hash_del_rcu (4a, 4e)
+# and free only after synchronize_rcu().
+if ! grep -A4 'void susfs_sus_ino_for_generic_fillattr' "$SUSFS_C" | grep -q 'rcu_read_lock'; then
+    echo "[+] Converting susfs_sus_ino_for_generic_fillattr to an RCU reader"
     sed -i '/^void susfs_sus_ino_for_generic_fillattr/,/^}/ {
-        /struct st_susfs_sus_kstat_hlist \*entry;/a \\tunsigned long flags;\n\n\tspin_lock_irqsave(\&susfs_spin_lock_sus_kstat, flags);
-        /return;/i \\t\t\tspin_unlock_irqrestore(\&susfs_spin_lock_sus_kstat, flags);
+        /struct st_susfs_sus_kstat_hlist \*entry;/a \\n\trcu_read_lock();
+        s/hash_for_each_possible(SUS_KSTAT_HLIST,/hash_for_each_possible_rcu(SUS_KSTAT_HLIST,/
+        /return;/i \\t\t\trcu_read_unlock();
     }' "$SUSFS_C"
     # Add unlock after the loop
     sed -i '/^void susfs_sus_ino_for_generic_fillattr/,/^}/ {
-        /^}/ i\\tspin_unlock_irqrestore(\&susfs_spin_lock_sus_kstat, flags);
+        /^}/ i\\trcu_read_unlock();
     }' "$SUSFS_C"
     ((fix_count++)) || true
 fi
 
 # 4c. susfs_sus_ino_for_show_map_vma: same pattern
-if ! grep -A3 'void susfs_sus_ino_for_show_map_vma' "$SUSFS_C" | grep -q 'unsigned long flags'; then
-    echo "[+] Fixing spin lock race in susfs_sus_ino_for_show_map_vma"
+if ! grep -A4 'void susfs_sus_ino_for_show_map_vma' "$SUSFS_C" | grep -q 'rcu_read_lock'; then
+    echo "[+] Converting susfs_sus_ino_for_show_map_vma to an RCU reader"
     sed -i '/^void susfs_sus_ino_for_show_map_vma/,/^}/ {
-        /struct st_susfs_sus_kstat_hlist \*entry;/a \\tunsigned long flags;\n\n\tspin_lock_irqsave(\&susfs_spin_lock_sus_kstat, flags);
-        /return;/i \\t\t\tspin_unlock_irqrestore(\&susfs_spin_lock_sus_kstat, flags);
+        /struct st_susfs_sus_kstat_hlist \*entry;/a \\n\trcu_read_lock();
+        s/hash_for_each_possible(SUS_KSTAT_HLIST,/hash_for_each_possible_rcu(SUS_KSTAT_HLIST,/
+        /return;/i \\t\t\trcu_read_unlock();
     }' "$SUSFS_C"
     sed -i '/^void susfs_sus_ino_for_show_map_vma/,/^}/ {
-        /^}/ i\\tspin_unlock_irqrestore(\&susfs_spin_lock_sus_kstat, flags);
+        /^}/ i\\trcu_read_unlock();
     }' "$SUSFS_C"
     ((fix_count++)) || true
 fi
@@ -265,6 +272,13 @@ if ! grep -A3 'susfs_get_redirected_path(unsigned long ino)' "$SUSFS_C" | grep -
     ((fix_count++)) || true
 fi
 
+# 4e. Every other SUS_KSTAT_HLIST insertion publishes to RCU readers
+if grep -q 'hash_add(SUS_KSTAT_HLIST,' "$SUSFS_C"; then
+    echo "[+] Switching SUS_KSTAT_HLIST insertions to hash_add_rcu"
+    sed -i 's/hash_add(SUS_KSTAT_HLIST,/hash_add_rcu(SUS_KSTAT_HLIST,/g' "$SUSFS_C"
+    ((fix_count++)) || true
+fi
+
 # --- 5. NULL deref fixes ---
 # 5a/5b: kzalloc returns NULL → code dereferences info->err.
 # Only replace the block inside if (!info) { ... }, not subsequent error paths.
@@ -23,6 +23,8 @@ echo "=== SUSFS Custom Handler Injection ==="
 HANDLERS=(
     "susfs_add_sus_kstat_redirect|CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT|CMD_SUSFS_ADD_SUS_KSTAT_STATICALLY|CONFIG_KSU_SUSFS_SUS_KSTAT|susfs_add_sus_kstat_redirect(arg)"
     "susfs_add_open_redirect_all|CMD_SUSFS_ADD_OPEN_REDIRECT_ALL|CMD_SUSFS_ADD_OPEN_REDIRECT|CONFIG_KSU_SUSFS_OPEN_REDIRECT|susfs_add_open_redirect_all(arg)"
+    "susfs_add_sus_kstat_redirect_batch|CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH|CMD_SUSFS_ADD_SUS_KSTAT_STATICALLY|CONFIG_KSU_SUSFS_SUS_KSTAT|susfs_add_sus_kstat_redirect_batch(arg)"
+    "susfs_add_open_redirect_all_batch|CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH|CMD_SUSFS_ADD_OPEN_REDIRECT|CONFIG_KSU_SUSFS_OPEN_REDIRECT|susfs_add_open_redirect_all_batch(arg)"
 )
 
 # Kconfig definitions: function_name|config_name|description|help_text
@@ -37,8 +39,9 @@ kconfig_count=0
 for entry in "${HANDLERS[@]}"; do
     IFS='|' read -r func cmd anchor_cmd anchor_endif handler_call <<< "$entry"
 
-    if grep -q "$func" "$SUSFS_SOURCE" 2>/dev/null; then
-        if [ -f "$SUPERCALLS" ] && ! grep -q "$cmd" "$SUPERCALLS"; then
+    # Word matches: CMD_X must not be satisfied by an existing CMD_X_BATCH
+    if grep -qw "$func" "$SUSFS_SOURCE" 2>/dev/null; then
+        if [ -f "$SUPERCALLS" ] && ! grep -qw "$cmd" "$SUPERCALLS"; then
             echo "[+] Injecting $cmd"
             sed -i "/$anchor_cmd/,/#endif.*$anchor_endif/ {
                 /#endif.*$anchor_endif/ i\\
@@ -1,7 +1,9 @@
 #!/bin/bash
 # inject-susfs-kstat-redirect.sh
 # Injects CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT (0x55573), the st_susfs_sus_kstat_redirect
-# struct, and susfs_add_sus_kstat_redirect() function into upstream SUSFS source.
+# struct, and susfs_add_sus_kstat_redirect() function into upstream SUSFS source,
+# plus the CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH (0x55574) variant that installs
+# many packed records in one call.
 #
 # Usage: ./inject-susfs-kstat-redirect.sh <SUSFS_KERNEL_PATCHES_DIR>
 
@@ -43,7 +45,29 @@ if ! grep -q 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT' "$SUSFS_DEF_H"; then
     exit 1
 fi
 
+# --- 1b. Batch CMD code and batch size cap in susfs_def.h ---
+if grep -q 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH' "$SUSFS_DEF_H"; then
+    echo "[=] CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH already present in susfs_def.h"
+else
+    echo "[+] Injecting CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH into susfs_def.h"
+    sed -i '/CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT 0x55573/a #define CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH 0x55574' "$SUSFS_DEF_H"
+    ((inject_count++)) || true
+fi
+# Shared with inject-susfs-open-redirect-all.sh; whichever runs first adds it
+if ! grep -q 'SUSFS_MAX_LEN_REDIRECT_BATCH' "$SUSFS_DEF_H"; then
+    sed -i '/CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH/a #define SUSFS_MAX_LEN_REDIRECT_BATCH 0x1000000' "$SUSFS_DEF_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH' "$SUSFS_DEF_H" || \
+   ! grep -q 'SUSFS_MAX_LEN_REDIRECT_BATCH' "$SUSFS_DEF_H"; then
+    echo "FATAL: CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH injection failed"
+    exit 1
+fi
+
 # --- 2. Struct in susfs.h ---
+# Userspace ABI for the single add (0x55573). Only its virtual path is kept,
+# in the table entry's info.target_pathname; the struct itself is not stored.
 if grep -q 'st_susfs_sus_kstat_redirect' "$SUSFS_H"; then
     echo "[=] st_susfs_sus_kstat_redirect already present in susfs.h"
 else
@@ -79,6 +103,73 @@ if ! grep -q 'st_susfs_sus_kstat_redirect' "$SUSFS_H"; then
     exit 1
 fi
 
+# --- 2b. Batch structs in susfs.h ---
+# A batch is a header pointing at count packed records. Each record is
+# rec_len bytes (a multiple of the record alignment) and ends with
+# "virtual\0real\0".
+if grep -q 'st_susfs_sus_kstat_redirect_batch' "$SUSFS_H"; then
+    echo "[=] st_susfs_sus_kstat_redirect_batch already present in susfs.h"
+else
+    echo "[+] Injecting st_susfs_sus_kstat_redirect_batch structs into susfs.h"
+    sed -i '/^struct st_susfs_sus_kstat_redirect {/,/^};/ {
+        /^};/ a\
+\
+struct st_susfs_sus_kstat_redirect_record {\
+\tunsigned int                            rec_len;\
+\tunsigned short                          virtual_len;\
+\tunsigned short                          real_len;\
+\tunsigned long                           spoofed_ino;\
+\tunsigned long                           spoofed_dev;\
+\tunsigned int                            spoofed_nlink;\
+\tlong long                               spoofed_size;\
+\tlong                                    spoofed_atime_tv_sec;\
+\tlong                                    spoofed_mtime_tv_sec;\
+\tlong                                    spoofed_ctime_tv_sec;\
+\tlong                                    spoofed_atime_tv_nsec;\
+\tlong                                    spoofed_mtime_tv_nsec;\
+\tlong                                    spoofed_ctime_tv_nsec;\
+\tunsigned long                           spoofed_blksize;\
+\tunsigned long long                      spoofed_blocks;\
+\tchar                                    pathnames[];\
+};\
+\
+struct st_susfs_sus_kstat_redirect_batch {\
+\tunsigned long long                      records;\
+\tunsigned int                            count;\
+\tunsigned int                            size;\
+\tunsigned int                            nr_done;\
+\tint                                     err;\
+};
+    }' "$SUSFS_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'st_susfs_sus_kstat_redirect_batch' "$SUSFS_H"; then
+    echo "FATAL: st_susfs_sus_kstat_redirect_batch struct injection failed"
+    exit 1
+fi
+
+# --- 2c. Redirect marker in st_susfs_sus_kstat_hlist ---
+# Redirect entries are counted in the TABLE stats and replaced when the same
+# redirect is added again; the marker tells them apart from plain sus_kstat
+# entries and the rcu head lets a replaced entry be freed under the lock.
+if grep -q 'is_redirect' "$SUSFS_H"; then
+    echo "[=] is_redirect already present in st_susfs_sus_kstat_hlist"
+else
+    echo "[+] Injecting is_redirect into st_susfs_sus_kstat_hlist"
+    sed -i '/^struct st_susfs_sus_kstat_hlist {/,/^};/ {
+        /^};/ i\
+\tbool                                    is_redirect;\
+\tstruct rcu_head                         rcu;
+    }' "$SUSFS_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'is_redirect' "$SUSFS_H"; then
+    echo "FATAL: is_redirect injection failed"
+    exit 1
+fi
+
 # --- 3. Function declaration in susfs.h ---
 if grep -q 'susfs_add_sus_kstat_redirect' "$SUSFS_H"; then
     echo "[=] susfs_add_sus_kstat_redirect declaration already present in susfs.h"
@@ -95,7 +186,21 @@ if ! grep -q 'susfs_add_sus_kstat_redirect' "$SUSFS_H"; then
     exit 1
 fi
 
-# --- 4. Function body in susfs.c ---
+# --- 3b. Batch function declaration in susfs.h ---
+if grep -q 'susfs_add_sus_kstat_redirect_batch' "$SUSFS_H"; then
+    echo "[=] susfs_add_sus_kstat_redirect_batch declaration already present in susfs.h"
+else
+    echo "[+] Injecting susfs_add_sus_kstat_redirect_batch declaration into susfs.h"
+    sed -i '/void susfs_add_sus_kstat_redirect(void __user \*\*user_info);/a void susfs_add_sus_kstat_redirect_batch(void __user **user_info);' "$SUSFS_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'susfs_add_sus_kstat_redirect_batch' "$SUSFS_H"; then
+    echo "FATAL: susfs_add_sus_kstat_redirect_batch declaration injection failed"
+    exit 1
+fi
+
+# --- 4. Function bodies in susfs.c ---
 if grep -q 'susfs_add_sus_kstat_redirect' "$SUSFS_C"; then
     echo "[=] susfs_add_sus_kstat_redirect function already present in susfs.c"
 else
@@ -107,9 +212,43 @@ else
     sed -i '/CMD_SUSFS_ADD_SUS_KSTAT_STATICALLY -> ret/,/^}/ {
         /^}/ a\
 \
-void susfs_add_sus_kstat_redirect(void __user **user_info) {\
-\tstruct st_susfs_sus_kstat_redirect info = {0};\
-\tstruct st_susfs_sus_kstat_hlist *new_entry = NULL;\
+/*\
+ * Redirect entries are plain st_susfs_sus_kstat_hlist nodes, because upstream\
+ * stat spoofing reads them straight out of SUS_KSTAT_HLIST. Their name is\
+ * info.target_pathname, a full SUSFS_MAX_LEN_PATHNAME array in the middle of\
+ * the sus_kstat userspace ABI struct, so unlike open-redirect-all these\
+ * entries are not exact-size. Count what they cost.\
+ */\
+static atomic_t susfs_sus_kstat_redirect_count = ATOMIC_INIT(0);\
+static atomic_long_t susfs_sus_kstat_redirect_bytes = ATOMIC_LONG_INIT(0);\
+\
+#define SUSFS_COPY_KSTAT_SPOOF(dst, src) do { \\\
+\t(dst)->spoofed_ino = (src)->spoofed_ino; \\\
+\t(dst)->spoofed_dev = (src)->spoofed_dev; \\\
+\t(dst)->spoofed_nlink = (src)->spoofed_nlink; \\\
+\t(dst)->spoofed_size = (src)->spoofed_size; \\\
+\t(dst)->spoofed_atime_tv_sec = (src)->spoofed_atime_tv_sec; \\\
+\t(dst)->spoofed_mtime_tv_sec = (src)->spoofed_mtime_tv_sec; \\\
+\t(dst)->spoofed_ctime_tv_sec = (src)->spoofed_ctime_tv_sec; \\\
+\t(dst)->spoofed_atime_tv_nsec = (src)->spoofed_atime_tv_nsec; \\\
+\t(dst)->spoofed_mtime_tv_nsec = (src)->spoofed_mtime_tv_nsec; \\\
+\t(dst)->spoofed_ctime_tv_nsec = (src)->spoofed_ctime_tv_nsec; \\\
+\t(dst)->spoofed_blksize = (src)->spoofed_blksize; \\\
+\t(dst)->spoofed_blocks = (src)->spoofed_blocks; \\\
+} while (0)\
+\
+/*\
+ * Resolve both paths of a redirect whose spoofed values are already in\
+ * new_entry, flag the inodes and fill in the keys. If the virtual path is a\
+ * different inode, a second entry keyed on it is returned in *virtual_out.\
+ * Nothing is hashed here, so callers can batch the inserts. The per-step\
+ * trace is only logged when verbose; batches would flood the kernel log.\
+ */\
+#define SUSFS_LOGI_IF(cond, fmt, ...) do { if (cond) SUSFS_LOGI(fmt, ##__VA_ARGS__); } while (0)\
+\
+static int susfs_build_sus_kstat_redirect(const char *virtual_pathname, const char *real_pathname,\
+\t\t\t\t\t  struct st_susfs_sus_kstat_hlist *new_entry,\
+\t\t\t\t\t  struct st_susfs_sus_kstat_hlist **virtual_out, bool verbose) {\
 \tstruct st_susfs_sus_kstat_hlist *virtual_entry = NULL;\
 \tstruct path p_real;\
 \tstruct path p_virtual;\
@@ -117,31 +256,23 @@ void susfs_add_sus_kstat_redirect(void __user **user_info) {\
 \tstruct inode *inode_virtual = NULL;\
 \tunsigned long virtual_ino = 0;\
 \tbool virtual_path_resolved = false;\
-\n\tif (copy_from_user(&info, (struct st_susfs_sus_kstat_redirect __user*)*user_info, sizeof(info))) {\
-\t\tinfo.err = -EFAULT;\
-\t\tgoto out_copy_to_user;\
-\t}\
-\n\tif (strlen(info.virtual_pathname) == 0 || strlen(info.real_pathname) == 0) {\
-\t\tinfo.err = -EINVAL;\
-\t\tgoto out_copy_to_user;\
-\t}\
-\n\tnew_entry = kzalloc(sizeof(struct st_susfs_sus_kstat_hlist), GFP_KERNEL);\
-\tif (!new_entry) {\
-\t\tinfo.err = -ENOMEM;\
-\t\tgoto out_copy_to_user;\
-\t}\
-\n#if defined(__ARCH_WANT_STAT64) || defined(__ARCH_WANT_COMPAT_STAT64)\
+\tint err;\
+\
+\t*virtual_out = NULL;\
+\
+#if defined(__ARCH_WANT_STAT64) || defined(__ARCH_WANT_COMPAT_STAT64)\
 #ifdef CONFIG_MIPS\
-\tinfo.spoofed_dev = new_decode_dev(info.spoofed_dev);\
+\tnew_entry->info.spoofed_dev = new_decode_dev(new_entry->info.spoofed_dev);\
 #else\
-\tinfo.spoofed_dev = huge_decode_dev(info.spoofed_dev);\
+\tnew_entry->info.spoofed_dev = huge_decode_dev(new_entry->info.spoofed_dev);\
 #endif /* CONFIG_MIPS */\
 #else\
-\tinfo.spoofed_dev = old_decode_dev(info.spoofed_dev);\
+\tnew_entry->info.spoofed_dev = old_decode_dev(new_entry->info.spoofed_dev);\
 #endif /* defined(__ARCH_WANT_STAT64) || defined(__ARCH_WANT_COMPAT_STAT64) */\
-\n\tSUSFS_LOGI("kstat_redirect: ENTRY vpath='"'"'%s'"'"' rpath='"'"'%s'"'"'\\n",\
-\t           info.virtual_pathname, info.real_pathname);\
-\tif (!kern_path(info.virtual_pathname, 0, &p_virtual)) {\
+\
+\tSUSFS_LOGI_IF(verbose, "kstat_redirect: ENTRY vpath='"'"'%s'"'"' rpath='"'"'%s'"'"'\\n",\
+\t           virtual_pathname, real_pathname);\
+\tif (!kern_path(virtual_pathname, 0, &p_virtual)) {\
 \t\tinode_virtual = d_backing_inode(p_virtual.dentry);\
 \t\tif (inode_virtual) {\
 \t\t\tvirtual_ino = inode_virtual->i_ino;\
@@ -151,79 +282,135 @@ void susfs_add_sus_kstat_redirect(void __user **user_info) {\
 \t\t\t\tspin_unlock(&inode_virtual->i_lock);\
 \t\t\t}\
 \t\t\tvirtual_path_resolved = true;\
-\t\t\tSUSFS_LOGI("kstat_redirect: VPATH_OK ino=%lu flagged='"'"'%s'"'"'\\n",\
-\t\t\t           virtual_ino, info.virtual_pathname);\
+\t\t\tSUSFS_LOGI_IF(verbose, "kstat_redirect: VPATH_OK ino=%lu flagged='"'"'%s'"'"'\\n",\
+\t\t\t           virtual_ino, virtual_pathname);\
 \t\t}\
 \t\tpath_put(&p_virtual);\
 \t} else {\
-\t\tSUSFS_LOGI("kstat_redirect: VPATH_MISSING '"'"'%s'"'"' (new file)\\n",\
-\t\t           info.virtual_pathname);\
+\t\tSUSFS_LOGI_IF(verbose, "kstat_redirect: VPATH_MISSING '"'"'%s'"'"' (new file)\\n",\
+\t\t           virtual_pathname);\
 \t}\
-\n\tinfo.err = kern_path(info.real_pathname, 0, &p_real);\
-\tif (info.err) {\
-\t\tSUSFS_LOGE("Failed opening real file '"'"'%s'"'"'\\n", info.real_pathname);\
-\t\tkfree(new_entry);\
-\t\tgoto out_copy_to_user;\
+\
+\terr = kern_path(real_pathname, 0, &p_real);\
+\tif (err) {\
+\t\tSUSFS_LOGE("Failed opening real file '"'"'%s'"'"'\\n", real_pathname);\
+\t\treturn err;\
 \t}\
-\n\tinode_real = d_backing_inode(p_real.dentry);\
+\
+\tinode_real = d_backing_inode(p_real.dentry);\
 \tif (!inode_real) {\
 \t\tpath_put(&p_real);\
-\t\tkfree(new_entry);\
-\t\tSUSFS_LOGE("inode is NULL for real file '"'"'%s'"'"'\\n", info.real_pathname);\
-\t\tinfo.err = -EINVAL;\
-\t\tgoto out_copy_to_user;\
+\t\tSUSFS_LOGE("inode is NULL for real file '"'"'%s'"'"'\\n", real_pathname);\
+\t\treturn -EINVAL;\
 \t}\
-\n\tif (!test_bit(AS_FLAGS_SUS_KSTAT, &inode_real->i_mapping->flags)) {\
+\
+\tif (!test_bit(AS_FLAGS_SUS_KSTAT, &inode_real->i_mapping->flags)) {\
 \t\tspin_lock(&inode_real->i_lock);\
 \t\tset_bit(AS_FLAGS_SUS_KSTAT, &inode_real->i_mapping->flags);\
 \t\tspin_unlock(&inode_real->i_lock);\
 \t}\
-\n\tnew_entry->target_ino = inode_real->i_ino;\
+\
+\tnew_entry->target_ino = inode_real->i_ino;\
+\tnew_entry->is_redirect = true;\
 \tnew_entry->info.is_statically = 0;\
 \tnew_entry->info.target_ino = inode_real->i_ino;\
-\tstrncpy(new_entry->info.target_pathname, info.virtual_pathname, SUSFS_MAX_LEN_PATHNAME - 1);\
+\tstrncpy(new_entry->info.target_pathname, virtual_pathname, SUSFS_MAX_LEN_PATHNAME - 1);\
 \tnew_entry->info.target_pathname[SUSFS_MAX_LEN_PATHNAME-1] = '"'"'\\0'"'"';\
-\tnew_entry->info.spoofed_ino = info.spoofed_ino;\
-\tnew_entry->info.spoofed_dev = info.spoofed_dev;\
-\tnew_entry->info.spoofed_nlink = info.spoofed_nlink;\
-\tnew_entry->info.spoofed_size = info.spoofed_size;\
-\tnew_entry->info.spoofed_atime_tv_sec = info.spoofed_atime_tv_sec;\
-\tnew_entry->info.spoofed_mtime_tv_sec = info.spoofed_mtime_tv_sec;\
-\tnew_entry->info.spoofed_ctime_tv_sec = info.spoofed_ctime_tv_sec;\
-\tnew_entry->info.spoofed_atime_tv_nsec = info.spoofed_atime_tv_nsec;\
-\tnew_entry->info.spoofed_mtime_tv_nsec = info.spoofed_mtime_tv_nsec;\
-\tnew_entry->info.spoofed_ctime_tv_nsec = info.spoofed_ctime_tv_nsec;\
-\tnew_entry->info.spoofed_blksize = info.spoofed_blksize;\
-\tnew_entry->info.spoofed_blocks = info.spoofed_blocks;\
-\n\tpath_put(&p_real);\
-\n\tif (virtual_path_resolved && virtual_ino != 0 && virtual_ino != new_entry->target_ino) {\
+\
+\tpath_put(&p_real);\
+\
+\tif (virtual_path_resolved && virtual_ino != 0 && virtual_ino != new_entry->target_ino) {\
 \t\tvirtual_entry = kzalloc(sizeof(struct st_susfs_sus_kstat_hlist), GFP_KERNEL);\
 \t\tif (!virtual_entry) {\
 \t\t\tSUSFS_LOGE("kstat_redirect: ALLOC_FAIL virtual_entry, aborting\\n");\
-\t\t\tkfree(new_entry);\
-\t\t\tinfo.err = -ENOMEM;\
-\t\t\tgoto out_copy_to_user;\
+\t\t\treturn -ENOMEM;\
 \t\t}\
 \t\tmemcpy(&virtual_entry->info, &new_entry->info, sizeof(new_entry->info));\
+\t\tvirtual_entry->is_redirect = true;\
 \t\tvirtual_entry->target_ino = virtual_ino;\
 \t\tvirtual_entry->info.target_ino = virtual_ino;\
 \t}\
-\n\tspin_lock(&susfs_spin_lock_sus_kstat);\
-\thash_add(SUS_KSTAT_HLIST, &new_entry->node, new_entry->target_ino);\
-\tif (virtual_entry) {\
-\t\thash_add(SUS_KSTAT_HLIST, &virtual_entry->node, virtual_ino);\
-\t}\
-\tspin_unlock(&susfs_spin_lock_sus_kstat);\
-\n\tSUSFS_LOGI("kstat_redirect: RPATH_OK ino=%lu dev=%lu '"'"'%s'"'"'\\n",\
-\t           new_entry->target_ino, new_entry->info.spoofed_dev, info.real_pathname);\
+\
+\tSUSFS_LOGI_IF(verbose, "kstat_redirect: RPATH_OK ino=%lu dev=%lu '"'"'%s'"'"'\\n",\
+\t           new_entry->target_ino, new_entry->info.spoofed_dev, real_pathname);\
 \tif (virtual_entry) {\
-\t\tSUSFS_LOGI("kstat_redirect: DUAL_INODE vino=%lu rino=%lu '"'"'%s'"'"'\\n",\
-\t\t           virtual_ino, new_entry->target_ino, info.virtual_pathname);\
+\t\tSUSFS_LOGI_IF(verbose, "kstat_redirect: DUAL_INODE vino=%lu rino=%lu '"'"'%s'"'"'\\n",\
+\t\t           virtual_ino, new_entry->target_ino, virtual_pathname);\
 \t} else if (virtual_path_resolved && virtual_ino == new_entry->target_ino) {\
-\t\tSUSFS_LOGI("kstat_redirect: SAME_INODE ino=%lu '"'"'%s'"'"'\\n",\
-\t\t           virtual_ino, info.virtual_pathname);\
+\t\tSUSFS_LOGI_IF(verbose, "kstat_redirect: SAME_INODE ino=%lu '"'"'%s'"'"'\\n",\
+\t\t           virtual_ino, virtual_pathname);\
+\t}\
+\
+\t*virtual_out = virtual_entry;\
+\treturn 0;\
+}\
+\
+/* Hash one redirect entry, replacing an earlier redirect of the same path on the same inode */\
+static void susfs_replace_sus_kstat_redirect_locked(struct st_susfs_sus_kstat_hlist *new_entry) {\
+\tstruct st_susfs_sus_kstat_hlist *old_entry;\
+\tstruct hlist_node *tmp_node;\
+\
+\thash_for_each_possible_safe(SUS_KSTAT_HLIST, old_entry, tmp_node, node, new_entry->target_ino) {\
+\t\tif (!old_entry->is_redirect || old_entry->target_ino != new_entry->target_ino ||\
+\t\t    strcmp(old_entry->info.target_pathname, new_entry->info.target_pathname))\
+\t\t\tcontinue;\
+\t\thash_del_rcu(&old_entry->node);\
+\t\tatomic_dec(&susfs_sus_kstat_redirect_count);\
+\t\tatomic_long_sub(sizeof(struct st_susfs_sus_kstat_hlist), &susfs_sus_kstat_redirect_bytes);\
+\t\tkfree_rcu(old_entry, rcu);\
+\t}\
+\thash_add_rcu(SUS_KSTAT_HLIST, &new_entry->node, new_entry->target_ino);\
+\tatomic_inc(&susfs_sus_kstat_redirect_count);\
+\tatomic_long_add(sizeof(struct st_susfs_sus_kstat_hlist), &susfs_sus_kstat_redirect_bytes);\
+}\
+\
+static void susfs_insert_sus_kstat_redirect_locked(struct st_susfs_sus_kstat_hlist *new_entry,\
+\t\t\t\t\t\t   struct st_susfs_sus_kstat_hlist *virtual_entry) {\
+\tlockdep_assert_held(&susfs_spin_lock_sus_kstat);\
+\
+\tsusfs_replace_sus_kstat_redirect_locked(new_entry);\
+\tif (virtual_entry)\
+\t\tsusfs_replace_sus_kstat_redirect_locked(virtual_entry);\
+}\
+\
+void susfs_add_sus_kstat_redirect(void __user **user_info) {\
+\tstruct st_susfs_sus_kstat_redirect info = {0};\
+\tstruct st_susfs_sus_kstat_hlist *new_entry = NULL;\
+\tstruct st_susfs_sus_kstat_hlist *virtual_entry = NULL;\
+\
+\tif (copy_from_user(&info, (struct st_susfs_sus_kstat_redirect __user*)*user_info, sizeof(info))) {\
+\t\tinfo.err = -EFAULT;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tif (strlen(info.virtual_pathname) == 0 || strlen(info.real_pathname) == 0) {\
+\t\tinfo.err = -EINVAL;\
+\t\tgoto out_copy_to_user;\
 \t}\
-\n#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)\
+\
+\tnew_entry = kzalloc(sizeof(struct st_susfs_sus_kstat_hlist), GFP_KERNEL);\
+\tif (!new_entry) {\
+\t\tinfo.err = -ENOMEM;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tSUSFS_COPY_KSTAT_SPOOF(&new_entry->info, &info);\
+\tinfo.err = susfs_build_sus_kstat_redirect(info.virtual_pathname, info.real_pathname,\
+\t\t\t\t\t\t  new_entry, &virtual_entry, true);\
+\tif (info.err) {\
+\t\tkfree(new_entry);\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tspin_lock(&susfs_spin_lock_sus_kstat);\
+\tsusfs_insert_sus_kstat_redirect_locked(new_entry, virtual_entry);\
+\tspin_unlock(&susfs_spin_lock_sus_kstat);\
+\
+\tSUSFS_LOGI("kstat_redirect: TABLE %d entries, %ld bytes\\n",\
+\t           atomic_read(&susfs_sus_kstat_redirect_count),\
+\t           atomic_long_read(&susfs_sus_kstat_redirect_bytes));\
+\
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)\
 \tSUSFS_LOGI("redirect: virtual: '"'"'%s'"'"', real: '"'"'%s'"'"', target_ino: '"'"'%lu'"'"', spoofed_ino: '"'"'%lu'"'"', spoofed_dev: '"'"'%lu'"'"', spoofed_nlink: '"'"'%u'"'"', spoofed_size: '"'"'%llu'"'"', spoofed_atime_tv_sec: '"'"'%ld'"'"', spoofed_mtime_tv_sec: '"'"'%ld'"'"', spoofed_ctime_tv_sec: '"'"'%ld'"'"', spoofed_atime_tv_nsec: '"'"'%ld'"'"', spoofed_mtime_tv_nsec: '"'"'%ld'"'"', spoofed_ctime_tv_nsec: '"'"'%ld'"'"', spoofed_blksize: '"'"'%lu'"'"', spoofed_blocks: '"'"'%llu'"'"', added to SUS_KSTAT_HLIST\\n",\
 \t\t\tinfo.virtual_pathname, info.real_pathname, new_entry->target_ino,\
 \t\t\tnew_entry->info.spoofed_ino, new_entry->info.spoofed_dev,\
@@ -240,19 +427,169 @@ void susfs_add_sus_kstat_redirect(void __user **user_info) {\
 \t\t\tnew_entry->info.spoofed_atime_tv_nsec, new_entry->info.spoofed_mtime_tv_nsec, new_entry->info.spoofed_ctime_tv_nsec,\
 \t\t\tnew_entry->info.spoofed_blksize, new_entry->info.spoofed_blocks);\
 #endif\
-\n\tinfo.err = 0;\
+\
+\tinfo.err = 0;\
 out_copy_to_user:\
 \tif (copy_to_user(&((struct st_susfs_sus_kstat_redirect __user*)*user_info)->err, &info.err, sizeof(info.err))) {\
 \t\tinfo.err = -EFAULT;\
 \t}\
 \tSUSFS_LOGI("kstat_redirect: EXIT ret=%d vpath='"'"'%s'"'"'\\n", info.err, info.virtual_pathname);\
+}\
+\
+/* Bounds-check one packed record; both paths must be NUL-terminated in place */\
+static const struct st_susfs_sus_kstat_redirect_record *\
+susfs_sus_kstat_redirect_record_at(const void *buf, unsigned int size, unsigned int off) {\
+\tconst struct st_susfs_sus_kstat_redirect_record *rec = buf + off;\
+\
+\tif (size - off < sizeof(*rec))\
+\t\treturn NULL;\
+\tif (rec->rec_len < sizeof(*rec) || rec->rec_len > size - off ||\
+\t    !IS_ALIGNED(rec->rec_len, __alignof__(*rec)))\
+\t\treturn NULL;\
+\tif (!rec->virtual_len || rec->virtual_len >= SUSFS_MAX_LEN_PATHNAME ||\
+\t    !rec->real_len || rec->real_len >= SUSFS_MAX_LEN_PATHNAME)\
+\t\treturn NULL;\
+\tif (sizeof(*rec) + rec->virtual_len + 1 + rec->real_len + 1 > rec->rec_len)\
+\t\treturn NULL;\
+\tif (strnlen(rec->pathnames, rec->virtual_len + 1) != rec->virtual_len ||\
+\t    strnlen(rec->pathnames + rec->virtual_len + 1, rec->real_len + 1) != rec->real_len)\
+\t\treturn NULL;\
+\treturn rec;\
+}\
+\
+/*\
+ * Install many redirects in one call. The whole buffer is validated before\
+ * any path is resolved; a record whose paths do not resolve is skipped and\
+ * its error is reported in err, while the rest are inserted under a single\
+ * hold of the kstat lock. nr_done is the number of records installed.\
+ */\
+void susfs_add_sus_kstat_redirect_batch(void __user **user_info) {\
+\tstruct st_susfs_sus_kstat_redirect_batch info = {0};\
+\tstruct st_susfs_sus_kstat_redirect_batch __user *uinfo = *user_info;\
+\tconst struct st_susfs_sus_kstat_redirect_record *rec;\
+\tstruct st_susfs_sus_kstat_hlist **entries = NULL;\
+\tstruct st_susfs_sus_kstat_hlist *new_entry, *virtual_entry;\
+\tunsigned int i, off, nr_built = 0;\
+\tvoid *buf = NULL;\
+\tint err;\
+\
+\tif (copy_from_user(&info, uinfo, sizeof(info))) {\
+\t\tinfo.err = -EFAULT;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\tinfo.err = 0;\
+\tinfo.nr_done = 0;\
+\
+\tif (!info.count || !info.size || info.size > SUSFS_MAX_LEN_REDIRECT_BATCH) {\
+\t\tinfo.err = -EINVAL;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tbuf = vmemdup_user(u64_to_user_ptr(info.records), info.size);\
+\tif (IS_ERR(buf)) {\
+\t\tinfo.err = PTR_ERR(buf);\
+\t\tbuf = NULL;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tfor (i = 0, off = 0; i < info.count; i++, off += rec->rec_len) {\
+\t\trec = susfs_sus_kstat_redirect_record_at(buf, info.size, off);\
+\t\tif (!rec) {\
+\t\t\tSUSFS_LOGE("kstat_redirect_batch: malformed record %u at offset %u\\n", i, off);\
+\t\t\tinfo.err = -EINVAL;\
+\t\t\tgoto out_free;\
+\t\t}\
+\t}\
+\
+\t// Real and virtual entry per record\
+\tentries = kvcalloc(info.count, 2 * sizeof(*entries), GFP_KERNEL);\
+\tif (!entries) {\
+\t\tinfo.err = -ENOMEM;\
+\t\tgoto out_free;\
+\t}\
+\
+\tfor (i = 0, off = 0; i < info.count; i++, off += rec->rec_len) {\
+\t\trec = buf + off;\
+\t\tnew_entry = kzalloc(sizeof(struct st_susfs_sus_kstat_hlist), GFP_KERNEL);\
+\t\tif (!new_entry) {\
+\t\t\tinfo.err = -ENOMEM;\
+\t\t\tgoto out_free_entries;\
+\t\t}\
+\t\tSUSFS_COPY_KSTAT_SPOOF(&new_entry->info, rec);\
+\t\terr = susfs_build_sus_kstat_redirect(rec->pathnames, rec->pathnames + rec->virtual_len + 1,\
+\t\t\t\t\t\t     new_entry, &virtual_entry, false);\
+\t\tif (err) {\
+\t\t\tkfree(new_entry);\
+\t\t\tif (err == -ENOMEM) {\
+\t\t\t\tinfo.err = err;\
+\t\t\t\tgoto out_free_entries;\
+\t\t\t}\
+\t\t\tif (!info.err)\
+\t\t\t\tinfo.err = err;\
+\t\t\tcontinue;\
+\t\t}\
+\t\tentries[2 * nr_built] = new_entry;\
+\t\tentries[2 * nr_built + 1] = virtual_entry;\
+\t\tnr_built++;\
+\t}\
+\
+\tspin_lock(&susfs_spin_lock_sus_kstat);\
+\tfor (i = 0; i < nr_built; i++)\
+\t\tsusfs_insert_sus_kstat_redirect_locked(entries[2 * i], entries[2 * i + 1]);\
+\tspin_unlock(&susfs_spin_lock_sus_kstat);\
+\tinfo.nr_done = nr_built;\
+\
+\tSUSFS_LOGI("kstat_redirect_batch: %u/%u installed, TABLE %d entries, %ld bytes\\n",\
+\t           info.nr_done, info.count,\
+\t           atomic_read(&susfs_sus_kstat_redirect_count),\
+\t           atomic_long_read(&susfs_sus_kstat_redirect_bytes));\
+\tgoto out_free;\
+\
+out_free_entries:\
+\tfor (i = 0; i < 2 * nr_built; i++)\
+\t\tkfree(entries[i]);\
+out_free:\
+\tkvfree(entries);\
+\tkvfree(buf);\
+out_copy_to_user:\
+\tif (copy_to_user(&uinfo->nr_done, &info.nr_done, sizeof(info.nr_done)) ||\
+\t    copy_to_user(&uinfo->err, &info.err, sizeof(info.err))) {\
+\t\tinfo.err = -EFAULT;\
+\t}\
+\tSUSFS_LOGI("CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH -> ret: %d\\n", info.err);\
 }
     }' "$SUSFS_C"
     ((inject_count++)) || true
 fi
 
+# --- 4b. Keep the redirect marker defined on upstream kstat entries ---
+# Upstream allocates kstat nodes with kmalloc, which would leave is_redirect
+# as garbage, and the update path swaps an entry for a fresh copy; without
+# the carry-over a redirect would lose its marker there.
+if grep -q 'kmalloc(sizeof(struct st_susfs_sus_kstat_hlist)' "$SUSFS_C"; then
+    echo "[+] Zeroing upstream st_susfs_sus_kstat_hlist allocations"
+    sed -i 's/kmalloc(sizeof(struct st_susfs_sus_kstat_hlist)/kzalloc(sizeof(struct st_susfs_sus_kstat_hlist)/g' "$SUSFS_C"
+    ((inject_count++)) || true
+fi
+
+if grep -q 'new_entry->is_redirect = tmp_entry->is_redirect' "$SUSFS_C"; then
+    echo "[=] is_redirect carry-over already present in susfs_update_sus_kstat"
+else
+    echo "[+] Injecting is_redirect carry-over into susfs_update_sus_kstat"
+    sed -i '/^void susfs_update_sus_kstat(/,/^}/ {
+        /hash_del\(_rcu\)\?(&tmp_entry->node);/ i\
+\t\t\tnew_entry->is_redirect = tmp_entry->is_redirect;
+    }' "$SUSFS_C"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'new_entry->is_redirect = tmp_entry->is_redirect' "$SUSFS_C"; then
+    echo "FATAL: is_redirect carry-over injection failed in susfs_update_sus_kstat"
+    exit 1
+fi
+
 # Validate
-if ! grep -q 'susfs_add_sus_kstat_redirect' "$SUSFS_C"; then
+if ! grep -q 'susfs_add_sus_kstat_redirect_batch' "$SUSFS_C"; then
     echo "FATAL: susfs_add_sus_kstat_redirect function injection failed"
     exit 1
 fi
@@ -1,6 +1,11 @@
 #!/bin/bash
-# Adds zeromount UID exclusion checks to the 3 show_* functions
-# (show_vfsmnt, show_mountinfo, show_vfsstat) in fs/proc_namespace.c.
+# Caches the reader's mount-hiding verdict in struct proc_mounts and makes the
+# 3 show_* functions (show_vfsmnt, show_mountinfo, show_vfsstat) in
+# fs/proc_namespace.c use it. The verdict (KSU domain, or zeromount-excluded
+# UID) is computed from current in m_start() (fs/namespace.c), once per read()
+# instead of once per mount line. It is not taken at open time: an fd opened
+# by an exempt process and passed to another one must not show it the
+# unfiltered list.
 # Runs AFTER the SUSFS GKI patch has been applied to kernel source.
 #
 # Usage: ./inject-susfs-mount-display.sh <KERNEL_COMMON_DIR>
@@ -15,40 +20,85 @@ if [ -z "$KERNEL_DIR" ]; then
 fi
 
 PROC_NS="$KERNEL_DIR/fs/proc_namespace.c"
+NAMESPACE_C="$KERNEL_DIR/fs/namespace.c"
+MOUNT_H="$KERNEL_DIR/fs/mount.h"
 
-if [ ! -f "$PROC_NS" ]; then
-    echo "FATAL: $PROC_NS not found"
-    exit 1
-fi
+for f in "$PROC_NS" "$NAMESPACE_C" "$MOUNT_H"; do
+    if [ ! -f "$f" ]; then
+        echo "FATAL: $f not found"
+        exit 1
+    fi
+done
 
 echo "=== inject-susfs-mount-display ==="
 echo "    Target: $PROC_NS"
 inject_count=0
 
-# --- 1. Add extern declaration ---
-if grep -q 'susfs_is_uid_zeromount_excluded' "$PROC_NS"; then
-    echo "[=] zeromount extern already present"
+# --- 1. Verdict field in struct proc_mounts (fs/mount.h) ---
+if grep -q 'susfs_reader_exempt' "$MOUNT_H"; then
+    echo "[=] proc_mounts.susfs_reader_exempt already present"
 else
-    echo "[+] Injecting zeromount extern declarations"
-    sed -i '/^extern bool susfs_is_current_ksu_domain(void);/a #ifdef CONFIG_ZEROMOUNT\nextern bool susfs_is_uid_zeromount_excluded(uid_t uid);\n#endif' "$PROC_NS"
+    echo "[+] Injecting susfs_reader_exempt into struct proc_mounts"
+    sed -i '/^struct proc_mounts {/a #ifdef CONFIG_KSU_SUSFS_SUS_MOUNT\n\tbool susfs_reader_exempt;\n#endif' "$MOUNT_H"
     ((inject_count++)) || true
 fi
 
-# --- 2. Inject zeromount condition into show_* blocks ---
+if ! grep -q 'susfs_reader_exempt' "$MOUNT_H"; then
+    echo "FATAL: struct proc_mounts anchor not found in $MOUNT_H"
+    exit 1
+fi
+
+# --- 2. Compute the verdict per read() in m_start() ---
+# seq_read() calls ->start under m->lock at the top of every read(), so the
+# verdict always belongs to the task doing the read, never to the opener.
+if grep -q 'susfs_is_uid_zeromount_excluded' "$NAMESPACE_C"; then
+    echo "[=] zeromount extern already present in namespace.c"
+else
+    echo "[+] Injecting reader verdict externs into namespace.c"
+    sed -i '/^#include "pnode.h"/a #ifdef CONFIG_KSU_SUSFS_SUS_MOUNT\nextern bool susfs_is_current_ksu_domain(void);\n#ifdef CONFIG_ZEROMOUNT\nextern bool susfs_is_uid_zeromount_excluded(uid_t uid);\n#endif\n#endif' "$NAMESPACE_C"
+    ((inject_count++)) || true
+fi
+
+if grep -q 'p->susfs_reader_exempt = ' "$NAMESPACE_C"; then
+    echo "[=] reader verdict already computed in m_start"
+else
+    echo "[+] Injecting reader verdict into m_start"
+    awk '
+    /^static void \*m_start\(struct seq_file \*m, loff_t \*pos\)/ { in_func = 1 }
+    in_func && /^\tdown_read\(&namespace_sem\);$/ && !done {
+        print
+        print "#ifdef CONFIG_KSU_SUSFS_SUS_MOUNT"
+        print "\tp->susfs_reader_exempt = susfs_is_current_ksu_domain()"
+        print "#ifdef CONFIG_ZEROMOUNT"
+        print "\t\t|| susfs_is_uid_zeromount_excluded(current_uid().val)"
+        print "#endif"
+        print "\t\t;"
+        print "#endif"
+        done = 1
+        in_func = 0
+        next
+    }
+    { print }
+    ' "$NAMESPACE_C" > "$NAMESPACE_C.tmp" && mv "$NAMESPACE_C.tmp" "$NAMESPACE_C"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'p->susfs_reader_exempt = ' "$NAMESPACE_C"; then
+    echo "FATAL: down_read(&namespace_sem); anchor not found in m_start"
+    exit 1
+fi
+
+# --- 3. Use the cached verdict in the show_* blocks ---
 # Upstream SUSFS adds:    !susfs_is_current_ksu_domain())
-# We split the closing ) and insert the zeromount guard before it.
-inline_count=$(grep -c '!susfs_is_uid_zeromount_excluded' "$PROC_NS" || true)
+# Each show_* already has p = m->private, so swap in the per-reader verdict.
+inline_count=$(grep -c '!p->susfs_reader_exempt)' "$PROC_NS" || true)
 if [ "$inline_count" -ge 3 ]; then
-    echo "[=] zeromount inline checks already present ($inline_count found)"
+    echo "[=] cached verdict already used in show_* functions ($inline_count found)"
 else
-    echo "[+] Injecting zeromount checks into show_* functions"
+    echo "[+] Replacing per-line checks in show_* functions"
     awk '
     /^\t\t!susfs_is_current_ksu_domain\(\)\)$/ {
-        print "\t\t!susfs_is_current_ksu_domain()"
-        print "#ifdef CONFIG_ZEROMOUNT"
-        print "\t\t&& !susfs_is_uid_zeromount_excluded(current_uid().val)"
-        print "#endif"
-        print "\t\t)"
+        print "\t\t!p->susfs_reader_exempt)"
         next
     }
     { print }
@@ -56,9 +106,9 @@ else
     ((inject_count++)) || true
 fi
 
-count=$(grep -c 'susfs_is_uid_zeromount_excluded' "$PROC_NS" || true)
-if [ "$count" -lt 4 ]; then
-    echo "FATAL: expected at least 4 zeromount references, found $count"
+count=$(grep -c '!p->susfs_reader_exempt)' "$PROC_NS" || true)
+if [ "$count" -lt 3 ]; then
+    echo "FATAL: expected at least 3 cached verdict checks, found $count"
     exit 1
 fi
 
@@ -1,8 +1,13 @@
 #!/bin/bash
 # inject-susfs-open-redirect-all.sh
 # Injects CMD_SUSFS_ADD_OPEN_REDIRECT_ALL (0x555c1), AS_FLAGS_OPEN_REDIRECT_ALL,
-# st_susfs_open_redirect_all_hlist struct, hash table, and 3 functions into
-# upstream SUSFS source.
+# st_susfs_open_redirect_all_hlist struct, hash table, and its functions into
+# upstream SUSFS source, plus the CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH (0x555c2)
+# variant that installs many packed records in one call.
+#
+# The table is keyed on (s_dev, i_ino) and read under RCU; the writer lock only
+# serializes adds. Each entry is refcounted, sized to its target path, and
+# carries an exact-size prebuilt struct filename for the redirect target.
 #
 # Usage: ./inject-susfs-open-redirect-all.sh <SUSFS_KERNEL_PATCHES_DIR>
 
@@ -38,6 +43,20 @@ else
     ((inject_count++)) || true
 fi
 
+# --- 1b. Batch CMD code and batch size cap in susfs_def.h ---
+if grep -q 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH' "$SUSFS_DEF_H"; then
+    echo "[=] CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH already present in susfs_def.h"
+else
+    echo "[+] Injecting CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH into susfs_def.h"
+    sed -i '/CMD_SUSFS_ADD_OPEN_REDIRECT_ALL 0x555c1/a #define CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH 0x555c2' "$SUSFS_DEF_H"
+    ((inject_count++)) || true
+fi
+# Shared with inject-susfs-kstat-redirect.sh; whichever runs first adds it
+if ! grep -q 'SUSFS_MAX_LEN_REDIRECT_BATCH' "$SUSFS_DEF_H"; then
+    sed -i '/CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH/a #define SUSFS_MAX_LEN_REDIRECT_BATCH 0x1000000' "$SUSFS_DEF_H"
+    ((inject_count++)) || true
+fi
+
 # --- 2. AS_FLAGS in susfs_def.h ---
 if grep -q 'AS_FLAGS_OPEN_REDIRECT_ALL' "$SUSFS_DEF_H"; then
     echo "[=] AS_FLAGS_OPEN_REDIRECT_ALL already present in susfs_def.h"
@@ -61,6 +80,11 @@ if ! grep -q 'AS_FLAGS_OPEN_REDIRECT_ALL' "$SUSFS_DEF_H"; then
     echo "FATAL: AS_FLAGS_OPEN_REDIRECT_ALL injection failed"
     exit 1
 fi
+if ! grep -q 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH' "$SUSFS_DEF_H" || \
+   ! grep -q 'SUSFS_MAX_LEN_REDIRECT_BATCH' "$SUSFS_DEF_H"; then
+    echo "FATAL: CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH injection failed"
+    exit 1
+fi
 
 # --- 3. Struct in susfs.h ---
 if grep -q 'st_susfs_open_redirect_all_hlist' "$SUSFS_H"; then
@@ -73,9 +97,14 @@ else
 \
 struct st_susfs_open_redirect_all_hlist {\
 \tunsigned long                           target_ino;\
-\tchar                                    target_pathname[SUSFS_MAX_LEN_PATHNAME];\
-\tchar                                    redirected_pathname[SUSFS_MAX_LEN_PATHNAME];\
+\tdev_t                                   target_dev;\
+\tatomic_t                                users;\
+\tstruct filename                         *redirected_name;\
 \tstruct hlist_node                       node;\
+\tstruct rcu_head                         rcu;\
+\tunsigned int                            target_len;\
+\tunsigned int                            redirected_len;\
+\tchar                                    target_pathname[];\
 };
     }' "$SUSFS_H"
     ((inject_count++)) || true
@@ -87,12 +116,46 @@ if ! grep -q 'st_susfs_open_redirect_all_hlist' "$SUSFS_H"; then
     exit 1
 fi
 
+# --- 3b. Batch structs in susfs.h ---
+# A batch is a header pointing at count packed records. Each record is
+# rec_len bytes (a multiple of the record alignment) and ends with
+# "target\0redirected\0".
+if grep -q 'st_susfs_open_redirect_all_batch' "$SUSFS_H"; then
+    echo "[=] st_susfs_open_redirect_all_batch already present in susfs.h"
+else
+    echo "[+] Injecting st_susfs_open_redirect_all_batch structs into susfs.h"
+    sed -i '/^struct st_susfs_open_redirect_all_hlist {/,/^};/ {
+        /^};/ a\
+\
+struct st_susfs_open_redirect_all_record {\
+\tunsigned int                            rec_len;\
+\tunsigned short                          target_len;\
+\tunsigned short                          redirected_len;\
+\tchar                                    pathnames[];\
+};\
+\
+struct st_susfs_open_redirect_all_batch {\
+\tunsigned long long                      records;\
+\tunsigned int                            count;\
+\tunsigned int                            size;\
+\tunsigned int                            nr_done;\
+\tint                                     err;\
+};
+    }' "$SUSFS_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'st_susfs_open_redirect_all_batch' "$SUSFS_H"; then
+    echo "FATAL: st_susfs_open_redirect_all_batch struct injection failed"
+    exit 1
+fi
+
 # --- 4. Function declarations in susfs.h ---
 if grep -q 'susfs_add_open_redirect_all' "$SUSFS_H"; then
     echo "[=] susfs_add_open_redirect_all declaration already present in susfs.h"
 else
     echo "[+] Injecting open_redirect_all declarations into susfs.h"
-    sed -i '/void susfs_add_open_redirect(void __user \*\*user_info);/a void susfs_add_open_redirect_all(void __user **user_info);\nstruct filename* susfs_get_redirected_path_all(unsigned long ino);' "$SUSFS_H"
+    sed -i '/void susfs_add_open_redirect(void __user \*\*user_info);/a void susfs_add_open_redirect_all(void __user **user_info);\nstruct filename* susfs_get_redirected_path_all(struct inode *inode, struct st_susfs_open_redirect_all_hlist **ref);\nvoid susfs_put_redirected_path_all(struct filename *name, struct st_susfs_open_redirect_all_hlist *ref);' "$SUSFS_H"
     ((inject_count++)) || true
 fi
 
@@ -102,12 +165,26 @@ if ! grep -q 'susfs_add_open_redirect_all' "$SUSFS_H"; then
     exit 1
 fi
 
-# --- 5. Hash table + spinlock in susfs.c ---
+# --- 4b. Batch function declaration in susfs.h ---
+if grep -q 'susfs_add_open_redirect_all_batch' "$SUSFS_H"; then
+    echo "[=] susfs_add_open_redirect_all_batch declaration already present in susfs.h"
+else
+    echo "[+] Injecting susfs_add_open_redirect_all_batch declaration into susfs.h"
+    sed -i '/void susfs_add_open_redirect_all(void __user \*\*user_info);/a void susfs_add_open_redirect_all_batch(void __user **user_info);' "$SUSFS_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'susfs_add_open_redirect_all_batch' "$SUSFS_H"; then
+    echo "FATAL: susfs_add_open_redirect_all_batch declaration injection failed"
+    exit 1
+fi
+
+# --- 5. Hash table, spinlock and memory counters in susfs.c ---
 if grep -q 'OPEN_REDIRECT_ALL_HLIST' "$SUSFS_C"; then
     echo "[=] OPEN_REDIRECT_ALL_HLIST already present in susfs.c"
 else
     echo "[+] Injecting OPEN_REDIRECT_ALL hash table into susfs.c"
-    sed -i '/DEFINE_HASHTABLE(OPEN_REDIRECT_HLIST, 10);/a static DEFINE_SPINLOCK(susfs_spin_lock_open_redirect_all);\nstatic DEFINE_HASHTABLE(OPEN_REDIRECT_ALL_HLIST, 10);' "$SUSFS_C"
+    sed -i '/DEFINE_HASHTABLE(OPEN_REDIRECT_HLIST, 10);/a static DEFINE_SPINLOCK(susfs_spin_lock_open_redirect_all);\nstatic DEFINE_HASHTABLE(OPEN_REDIRECT_ALL_HLIST, 10);\nstatic atomic_t susfs_open_redirect_all_count = ATOMIC_INIT(0);\nstatic atomic_long_t susfs_open_redirect_all_bytes = ATOMIC_LONG_INIT(0);' "$SUSFS_C"
     ((inject_count++)) || true
 fi
 
@@ -117,7 +194,21 @@ if ! grep -q 'OPEN_REDIRECT_ALL_HLIST' "$SUSFS_C"; then
     exit 1
 fi
 
-# --- 6. Three functions in susfs.c ---
+# --- 6. #include <linux/audit.h> in susfs.c (audit_dummy_context) ---
+if grep -q '#include <linux/audit.h>' "$SUSFS_C"; then
+    echo "[=] #include <linux/audit.h> already present in susfs.c"
+else
+    echo "[+] Injecting #include <linux/audit.h> into susfs.c"
+    sed -i '/#include <linux\/susfs.h>/a #include <linux/audit.h>' "$SUSFS_C"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q '#include <linux/audit.h>' "$SUSFS_C"; then
+    echo "FATAL: #include <linux/audit.h> injection failed"
+    exit 1
+fi
+
+# --- 7. open_redirect_all functions in susfs.c ---
 if grep -q 'susfs_update_open_redirect_all_inode' "$SUSFS_C"; then
     echo "[=] open_redirect_all functions already present in susfs.c"
 else
@@ -127,57 +218,200 @@ else
     sed -i '/CMD_SUSFS_ADD_OPEN_REDIRECT -> ret/,/^}/ {
         /^}/ a\
 \
-static int susfs_update_open_redirect_all_inode(struct st_susfs_open_redirect_all_hlist *new_entry) {\
+static inline unsigned long susfs_open_redirect_all_key(dev_t dev, unsigned long ino) {\
+\treturn ino ^ dev;\
+}\
+\
+/*\
+ * Exact-size struct filename for a redirect target. It is only ever lent out\
+ * by reference and is freed with its entry. The entry holds the one\
+ * reference, so a getname user that takes and drops its own (audit) can\
+ * never bring refcnt to zero and putname() memory the table still owns.\
+ */\
+static struct filename *susfs_alloc_redirect_name(const char *path, size_t len) {\
+\tstruct filename *name;\
+\
+\tname = kzalloc(offsetof(struct filename, iname) + len + 1, GFP_KERNEL);\
+\tif (!name)\
+\t\treturn ERR_PTR(-ENOMEM);\
+\tmemcpy((char *)name->iname, path, len);\
+\tname->name = name->iname;\
+\t// refcnt is an int on older trees and an atomic_t from 6.7 and some stables\
+\t_Generic(name->refcnt,\
+\t\t atomic_t: atomic_set((atomic_t *)&name->refcnt, 1),\
+\t\t default: (void)(*(int *)&name->refcnt = 1));\
+\treturn name;\
+}\
+\
+static size_t susfs_open_redirect_all_size(struct st_susfs_open_redirect_all_hlist *entry) {\
+\treturn struct_size(entry, target_pathname, entry->target_len + 1) +\
+\t       offsetof(struct filename, iname) + entry->redirected_len + 1;\
+}\
+\
+static void susfs_open_redirect_all_free_rcu(struct rcu_head *head) {\
+\tstruct st_susfs_open_redirect_all_hlist *entry =\
+\t\tcontainer_of(head, struct st_susfs_open_redirect_all_hlist, rcu);\
+\
+\tatomic_long_sub(susfs_open_redirect_all_size(entry), &susfs_open_redirect_all_bytes);\
+\tatomic_dec(&susfs_open_redirect_all_count);\
+\tkfree(entry->redirected_name);\
+\tkfree(entry);\
+}\
+\
+static void susfs_put_open_redirect_all_entry(struct st_susfs_open_redirect_all_hlist *entry) {\
+\tif (atomic_dec_and_test(&entry->users))\
+\t\tcall_rcu(&entry->rcu, susfs_open_redirect_all_free_rcu);\
+}\
+\
+/*\
+ * Resolve the target and key the entry on it. The inode is returned with a\
+ * reference and is only flagged once its entry is hashed, so an entry that\
+ * never makes it into the table leaves no flag behind.\
+ */\
+static int susfs_update_open_redirect_all_inode(struct st_susfs_open_redirect_all_hlist *new_entry,\
+\t\t\t\t\t\tstruct inode **inode_out) {\
 \tstruct path path_target;\
 \tstruct inode *inode_target;\
 \tint err = 0;\
-\n\terr = kern_path(new_entry->target_pathname, LOOKUP_FOLLOW, &path_target);\
+\
+\terr = kern_path(new_entry->target_pathname, LOOKUP_FOLLOW, &path_target);\
 \tif (err) {\
 \t\tSUSFS_LOGE("Failed opening file '"'"'%s'"'"'\\n", new_entry->target_pathname);\
 \t\treturn err;\
 \t}\
-\n\tinode_target = d_backing_inode(path_target.dentry);\
+\
+\tinode_target = d_backing_inode(path_target.dentry);\
 \tif (!inode_target) {\
 \t\tSUSFS_LOGE("inode_target is NULL\\n");\
 \t\terr = -EINVAL;\
 \t\tgoto out_path_put_target;\
 \t}\
-\n\tspin_lock(&inode_target->i_lock);\
-\tset_bit(AS_FLAGS_OPEN_REDIRECT_ALL, &inode_target->i_mapping->flags);\
-\tspin_unlock(&inode_target->i_lock);\
-\nout_path_put_target:\
+\
+\t// Key on what the lookup hook will see, not on what userspace claimed\
+\tnew_entry->target_ino = inode_target->i_ino;\
+\tnew_entry->target_dev = inode_target->i_sb->s_dev;\
+\tihold(inode_target);\
+\t*inode_out = inode_target;\
+\
+out_path_put_target:\
 \tpath_put(&path_target);\
 \treturn err;\
 }\
 \
+static void susfs_flag_open_redirect_all_inode(struct inode *inode) {\
+\tspin_lock(&inode->i_lock);\
+\tset_bit(AS_FLAGS_OPEN_REDIRECT_ALL, &inode->i_mapping->flags);\
+\tspin_unlock(&inode->i_lock);\
+}\
+\
+/*\
+ * Allocate an entry for target -> redirected and resolve its target inode,\
+ * returned referenced in *inode_out. Nothing is hashed or flagged here, so\
+ * callers can batch the inserts.\
+ */\
+static struct st_susfs_open_redirect_all_hlist *\
+susfs_build_open_redirect_all(const char *target_pathname, size_t target_len,\
+\t\t\t      const char *redirected_pathname, size_t redirected_len,\
+\t\t\t      struct inode **inode_out) {\
+\tstruct st_susfs_open_redirect_all_hlist *new_entry;\
+\tint err;\
+\
+\t// Sized to the paths, not to SUSFS_MAX_LEN_PATHNAME\
+\tnew_entry = kzalloc(struct_size(new_entry, target_pathname, target_len + 1), GFP_KERNEL);\
+\tif (!new_entry)\
+\t\treturn ERR_PTR(-ENOMEM);\
+\
+\tmemcpy(new_entry->target_pathname, target_pathname, target_len);\
+\tnew_entry->target_len = target_len;\
+\tnew_entry->redirected_len = redirected_len;\
+\tatomic_set(&new_entry->users, 1);\
+\
+\t// Built once here so the open path does not need getname_kernel()\
+\tnew_entry->redirected_name = susfs_alloc_redirect_name(redirected_pathname, redirected_len);\
+\tif (IS_ERR(new_entry->redirected_name)) {\
+\t\terr = PTR_ERR(new_entry->redirected_name);\
+\t\tkfree(new_entry);\
+\t\treturn ERR_PTR(err);\
+\t}\
+\
+\terr = susfs_update_open_redirect_all_inode(new_entry, inode_out);\
+\tif (err) {\
+\t\tSUSFS_LOGE("failed adding path '"'"'%s'"'"' to OPEN_REDIRECT_ALL_HLIST\\n", new_entry->target_pathname);\
+\t\tkfree(new_entry->redirected_name);\
+\t\tkfree(new_entry);\
+\t\treturn ERR_PTR(err);\
+\t}\
+\treturn new_entry;\
+}\
+\
+/*\
+ * Re-adding an inode replaces its target; readers still holding the old\
+ * entry keep it alive. The target inode is flagged only now that the entry\
+ * is in the table. Returns true if an entry was replaced.\
+ */\
+static bool susfs_insert_open_redirect_all_locked(struct st_susfs_open_redirect_all_hlist *new_entry,\
+\t\t\t\t\t\t  struct inode *inode) {\
+\tstruct st_susfs_open_redirect_all_hlist *entry, *old_entry = NULL;\
+\tunsigned long key = susfs_open_redirect_all_key(new_entry->target_dev, new_entry->target_ino);\
+\
+\tlockdep_assert_held(&susfs_spin_lock_open_redirect_all);\
+\
+\thash_for_each_possible(OPEN_REDIRECT_ALL_HLIST, entry, node, key) {\
+\t\tif (entry->target_ino == new_entry->target_ino && entry->target_dev == new_entry->target_dev) {\
+\t\t\thlist_replace_rcu(&entry->node, &new_entry->node);\
+\t\t\told_entry = entry;\
+\t\t\tbreak;\
+\t\t}\
+\t}\
+\tif (!old_entry)\
+\t\thash_add_rcu(OPEN_REDIRECT_ALL_HLIST, &new_entry->node, key);\
+\tsusfs_flag_open_redirect_all_inode(inode);\
+\tatomic_long_add(susfs_open_redirect_all_size(new_entry), &susfs_open_redirect_all_bytes);\
+\tatomic_inc(&susfs_open_redirect_all_count);\
+\t// Only queues an RCU callback, fine under the spinlock\
+\tif (old_entry)\
+\t\tsusfs_put_open_redirect_all_entry(old_entry);\
+\treturn old_entry != NULL;\
+}\
+\
 void susfs_add_open_redirect_all(void __user **user_info) {\
 \tstruct st_susfs_open_redirect info = {0};\
 \tstruct st_susfs_open_redirect_all_hlist *new_entry;\
-\n\tif (copy_from_user(&info, (struct st_susfs_open_redirect __user*)*user_info, sizeof(info))) {\
+\tstruct inode *inode = NULL;\
+\tsize_t target_len, redirected_len;\
+\tbool replaced;\
+\
+\tif (copy_from_user(&info, (struct st_susfs_open_redirect __user*)*user_info, sizeof(info))) {\
 \t\tinfo.err = -EFAULT;\
 \t\tgoto out_copy_to_user;\
 \t}\
-\n\tnew_entry = kmalloc(sizeof(struct st_susfs_open_redirect_all_hlist), GFP_KERNEL);\
-\tif (!new_entry) {\
-\t\tinfo.err = -ENOMEM;\
+\
+\ttarget_len = strnlen(info.target_pathname, SUSFS_MAX_LEN_PATHNAME - 1);\
+\tredirected_len = strnlen(info.redirected_pathname, SUSFS_MAX_LEN_PATHNAME - 1);\
+\tif (!target_len || !redirected_len) {\
+\t\tinfo.err = -EINVAL;\
 \t\tgoto out_copy_to_user;\
 \t}\
-\n\tnew_entry->target_ino = info.target_ino;\
-\tstrncpy(new_entry->target_pathname, info.target_pathname, SUSFS_MAX_LEN_PATHNAME-1);\
-\tnew_entry->target_pathname[SUSFS_MAX_LEN_PATHNAME-1] = '"'"'\\0'"'"';\
-\tstrncpy(new_entry->redirected_pathname, info.redirected_pathname, SUSFS_MAX_LEN_PATHNAME-1);\
-\tnew_entry->redirected_pathname[SUSFS_MAX_LEN_PATHNAME-1] = '"'"'\\0'"'"';\
-\tif (susfs_update_open_redirect_all_inode(new_entry)) {\
-\t\tSUSFS_LOGE("failed adding path '"'"'%s'"'"' to OPEN_REDIRECT_ALL_HLIST\\n", new_entry->target_pathname);\
-\t\tkfree(new_entry);\
-\t\tinfo.err = -EINVAL;\
+\
+\tnew_entry = susfs_build_open_redirect_all(info.target_pathname, target_len,\
+\t\t\t\t\t\t  info.redirected_pathname, redirected_len, &inode);\
+\tif (IS_ERR(new_entry)) {\
+\t\tinfo.err = PTR_ERR(new_entry) == -ENOMEM ? -ENOMEM : -EINVAL;\
 \t\tgoto out_copy_to_user;\
 \t}\
-\n\tspin_lock(&susfs_spin_lock_open_redirect_all);\
-\thash_add(OPEN_REDIRECT_ALL_HLIST, &new_entry->node, info.target_ino);\
+\
+\tspin_lock(&susfs_spin_lock_open_redirect_all);\
+\treplaced = susfs_insert_open_redirect_all_locked(new_entry, inode);\
+\tSUSFS_LOGI("target_ino: '"'"'%lu'"'"', target_dev: '"'"'%u'"'"', target_pathname: '"'"'%s'"'"' redirected_pathname: '"'"'%s'"'"', is successfully %s OPEN_REDIRECT_ALL_HLIST\\n",\
+\t\t\tnew_entry->target_ino, new_entry->target_dev, new_entry->target_pathname,\
+\t\t\tnew_entry->redirected_name->name, replaced ? "updated in" : "added to");\
 \tspin_unlock(&susfs_spin_lock_open_redirect_all);\
-\tSUSFS_LOGI("target_ino: '"'"'%lu'"'"', target_pathname: '"'"'%s'"'"' redirected_pathname: '"'"'%s'"'"', is successfully added to OPEN_REDIRECT_ALL_HLIST\\n",\
-\t\t\tnew_entry->target_ino, new_entry->target_pathname, new_entry->redirected_pathname);\
+\tiput(inode);\
+\
+\t// Replaced entries are counted until their RCU grace period ends\
+\tSUSFS_LOGI("OPEN_REDIRECT_ALL_HLIST: %d entries, %ld bytes\\n",\
+\t\t\tatomic_read(&susfs_open_redirect_all_count),\
+\t\t\tatomic_long_read(&susfs_open_redirect_all_bytes));\
 \tinfo.err = 0;\
 out_copy_to_user:\
 \tif (copy_to_user(&((struct st_susfs_open_redirect __user*)*user_info)->err, &info.err, sizeof(info.err))) {\
@@ -186,19 +420,172 @@ out_copy_to_user:\
 \tSUSFS_LOGI("CMD_SUSFS_ADD_OPEN_REDIRECT_ALL -> ret: %d\\n", info.err);\
 }\
 \
-struct filename* susfs_get_redirected_path_all(unsigned long ino) {\
-\tstruct st_susfs_open_redirect_all_hlist *entry;\
-\tstruct filename *result = ERR_PTR(-ENOENT);\
-\n\tspin_lock(&susfs_spin_lock_open_redirect_all);\
-\thash_for_each_possible(OPEN_REDIRECT_ALL_HLIST, entry, node, ino) {\
-\t\tif (entry->target_ino == ino) {\
-\t\t\tSUSFS_LOGI("Redirect_all for ino: %lu\\n", ino);\
-\t\t\tresult = getname_kernel(entry->redirected_pathname);\
-\t\t\tbreak;\
+/* Bounds-check one packed record; both paths must be NUL-terminated in place */\
+static const struct st_susfs_open_redirect_all_record *\
+susfs_open_redirect_all_record_at(const void *buf, unsigned int size, unsigned int off) {\
+\tconst struct st_susfs_open_redirect_all_record *rec = buf + off;\
+\
+\tif (size - off < sizeof(*rec))\
+\t\treturn NULL;\
+\tif (rec->rec_len < sizeof(*rec) || rec->rec_len > size - off ||\
+\t    !IS_ALIGNED(rec->rec_len, __alignof__(*rec)))\
+\t\treturn NULL;\
+\tif (!rec->target_len || rec->target_len >= SUSFS_MAX_LEN_PATHNAME ||\
+\t    !rec->redirected_len || rec->redirected_len >= SUSFS_MAX_LEN_PATHNAME)\
+\t\treturn NULL;\
+\tif (sizeof(*rec) + rec->target_len + 1 + rec->redirected_len + 1 > rec->rec_len)\
+\t\treturn NULL;\
+\tif (strnlen(rec->pathnames, rec->target_len + 1) != rec->target_len ||\
+\t    strnlen(rec->pathnames + rec->target_len + 1, rec->redirected_len + 1) != rec->redirected_len)\
+\t\treturn NULL;\
+\treturn rec;\
+}\
+\
+/*\
+ * Install many redirects in one call. The whole buffer is validated before\
+ * any path is resolved; a record whose target does not resolve is skipped and\
+ * its error is reported in err, while the rest are inserted under a single\
+ * hold of the writer lock. nr_done is the number of records installed.\
+ */\
+void susfs_add_open_redirect_all_batch(void __user **user_info) {\
+\tstruct st_susfs_open_redirect_all_batch info = {0};\
+\tstruct st_susfs_open_redirect_all_batch __user *uinfo = *user_info;\
+\tconst struct st_susfs_open_redirect_all_record *rec;\
+\tstruct st_susfs_open_redirect_all_hlist **entries = NULL;\
+\tstruct st_susfs_open_redirect_all_hlist *new_entry;\
+\tstruct inode **inodes = NULL;\
+\tunsigned int i, off, nr_built = 0, nr_replaced = 0;\
+\tvoid *buf = NULL;\
+\
+\tif (copy_from_user(&info, uinfo, sizeof(info))) {\
+\t\tinfo.err = -EFAULT;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\tinfo.err = 0;\
+\tinfo.nr_done = 0;\
+\
+\tif (!info.count || !info.size || info.size > SUSFS_MAX_LEN_REDIRECT_BATCH) {\
+\t\tinfo.err = -EINVAL;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tbuf = vmemdup_user(u64_to_user_ptr(info.records), info.size);\
+\tif (IS_ERR(buf)) {\
+\t\tinfo.err = PTR_ERR(buf);\
+\t\tbuf = NULL;\
+\t\tgoto out_copy_to_user;\
+\t}\
+\
+\tfor (i = 0, off = 0; i < info.count; i++, off += rec->rec_len) {\
+\t\trec = susfs_open_redirect_all_record_at(buf, info.size, off);\
+\t\tif (!rec) {\
+\t\t\tSUSFS_LOGE("open_redirect_all_batch: malformed record %u at offset %u\\n", i, off);\
+\t\t\tinfo.err = -EINVAL;\
+\t\t\tgoto out_free;\
+\t\t}\
+\t}\
+\
+\t// Entries in the first half, their referenced target inodes in the second\
+\tentries = kvcalloc(info.count, 2 * sizeof(*entries), GFP_KERNEL);\
+\tif (!entries) {\
+\t\tinfo.err = -ENOMEM;\
+\t\tgoto out_free;\
+\t}\
+\tinodes = (struct inode **)(entries + info.count);\
+\
+\tfor (i = 0, off = 0; i < info.count; i++, off += rec->rec_len) {\
+\t\trec = buf + off;\
+\t\tnew_entry = susfs_build_open_redirect_all(rec->pathnames, rec->target_len,\
+\t\t\t\t\t\t\t  rec->pathnames + rec->target_len + 1,\
+\t\t\t\t\t\t\t  rec->redirected_len, &inodes[nr_built]);\
+\t\tif (IS_ERR(new_entry)) {\
+\t\t\tif (PTR_ERR(new_entry) == -ENOMEM) {\
+\t\t\t\tinfo.err = -ENOMEM;\
+\t\t\t\tgoto out_free_entries;\
+\t\t\t}\
+\t\t\tif (!info.err)\
+\t\t\t\tinfo.err = PTR_ERR(new_entry);\
+\t\t\tcontinue;\
 \t\t}\
+\t\tentries[nr_built++] = new_entry;\
+\t}\
+\
+\tspin_lock(&susfs_spin_lock_open_redirect_all);\
+\tfor (i = 0; i < nr_built; i++) {\
+\t\tif (susfs_insert_open_redirect_all_locked(entries[i], inodes[i]))\
+\t\t\tnr_replaced++;\
 \t}\
 \tspin_unlock(&susfs_spin_lock_open_redirect_all);\
+\tfor (i = 0; i < nr_built; i++)\
+\t\tiput(inodes[i]);\
+\tinfo.nr_done = nr_built;\
+\
+\tSUSFS_LOGI("OPEN_REDIRECT_ALL_HLIST: batch %u/%u installed (%u replaced), %d entries, %ld bytes\\n",\
+\t\t\tinfo.nr_done, info.count, nr_replaced,\
+\t\t\tatomic_read(&susfs_open_redirect_all_count),\
+\t\t\tatomic_long_read(&susfs_open_redirect_all_bytes));\
+\tgoto out_free;\
+\
+out_free_entries:\
+\t// Never hashed, so their inodes were never flagged\
+\tfor (i = 0; i < nr_built; i++) {\
+\t\tiput(inodes[i]);\
+\t\tkfree(entries[i]->redirected_name);\
+\t\tkfree(entries[i]);\
+\t}\
+out_free:\
+\tkvfree(entries);\
+\tkvfree(buf);\
+out_copy_to_user:\
+\tif (copy_to_user(&uinfo->nr_done, &info.nr_done, sizeof(info.nr_done)) ||\
+\t    copy_to_user(&uinfo->err, &info.err, sizeof(info.err))) {\
+\t\tinfo.err = -EFAULT;\
+\t}\
+\tSUSFS_LOGI("CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH -> ret: %d\\n", info.err);\
+}\
+\
+/*\
+ * Lock-free lookup keyed on (s_dev, i_ino). On success *ref is set when the\
+ * entry'"'"'s prebuilt name is handed out: it stays valid until\
+ * susfs_put_redirected_path_all(). The name is only shared while audit is\
+ * idle, since audit attaches per-syscall state to struct filename; otherwise\
+ * the caller gets a private copy.\
+ */\
+struct filename* susfs_get_redirected_path_all(struct inode *inode, struct st_susfs_open_redirect_all_hlist **ref) {\
+\tstruct st_susfs_open_redirect_all_hlist *entry, *found = NULL;\
+\tunsigned long ino = inode->i_ino;\
+\tdev_t dev = inode->i_sb->s_dev;\
+\tstruct filename *result;\
+\
+\t*ref = NULL;\
+\trcu_read_lock();\
+\thash_for_each_possible_rcu(OPEN_REDIRECT_ALL_HLIST, entry, node, susfs_open_redirect_all_key(dev, ino)) {\
+\t\tif (entry->target_ino == ino && entry->target_dev == dev &&\
+\t\t    atomic_inc_not_zero(&entry->users)) {\
+\t\t\tfound = entry;\
+\t\t\tbreak;\
+\t\t}\
+\t}\
+\trcu_read_unlock();\
+\
+\tif (!found)\
+\t\treturn ERR_PTR(-ENOENT);\
+\
+\tSUSFS_LOGI("Redirect_all for ino: %lu\\n", ino);\
+\tif (audit_dummy_context()) {\
+\t\t*ref = found;\
+\t\treturn found->redirected_name;\
+\t}\
+\tresult = getname_kernel(found->redirected_name->name);\
+\tsusfs_put_open_redirect_all_entry(found);\
 \treturn result;\
+}\
+\
+void susfs_put_redirected_path_all(struct filename *name, struct st_susfs_open_redirect_all_hlist *ref) {\
+\tif (ref)\
+\t\tsusfs_put_open_redirect_all_entry(ref);\
+\telse\
+\t\tputname(name);\
 }
     }' "$SUSFS_C"
     ((inject_count++)) || true
@@ -217,5 +604,9 @@ if ! grep -q 'susfs_update_open_redirect_all_inode' "$SUSFS_C"; then
     echo "FATAL: susfs_update_open_redirect_all_inode function injection failed"
     exit 1
 fi
+if ! grep -q 'susfs_add_open_redirect_all_batch' "$SUSFS_C"; then
+    echo "FATAL: susfs_add_open_redirect_all_batch function injection failed"
+    exit 1
+fi
 
 echo "=== Done: $inject_count injections applied ==="
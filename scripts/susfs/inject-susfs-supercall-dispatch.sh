@@ -1,7 +1,8 @@
 #!/bin/bash
 # inject-susfs-supercall-dispatch.sh
-# Adds CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT and CMD_SUSFS_ADD_OPEN_REDIRECT_ALL
-# case handlers into the KSU supercalls dispatch in 10_enable_susfs_for_ksu.patch.
+# Adds CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT, CMD_SUSFS_ADD_OPEN_REDIRECT_ALL and
+# their _BATCH variants as case handlers into the KSU supercalls dispatch in
+# 10_enable_susfs_for_ksu.patch.
 #
 # NOTE: Currently unused in the metamodule build pipeline. The build uses
 # KernelSU-Next's dev_susfs branch (which has SUSFS pre-integrated), so
@@ -33,7 +34,7 @@ echo "=== inject-susfs-supercall-dispatch ==="
 inject_count=0
 
 # --- 1. kstat_redirect handler ---
-if grep -q 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT' "$KSU_PATCH"; then
+if grep -qw 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT' "$KSU_PATCH"; then
     echo "[=] CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT handler already present"
 else
     echo "[+] Injecting CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT handler"
@@ -61,7 +62,7 @@ if ! grep -q 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT' "$KSU_PATCH"; then
 fi
 
 # --- 2. open_redirect_all handler ---
-if grep -q 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL' "$KSU_PATCH"; then
+if grep -qw 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL' "$KSU_PATCH"; then
     echo "[=] CMD_SUSFS_ADD_OPEN_REDIRECT_ALL handler already present"
 else
     echo "[+] Injecting CMD_SUSFS_ADD_OPEN_REDIRECT_ALL handler"
@@ -82,4 +83,48 @@ if ! grep -q 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL' "$KSU_PATCH"; then
     exit 1
 fi
 
+# --- 3. kstat_redirect batch handler ---
+if grep -qw 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH' "$KSU_PATCH"; then
+    echo "[=] CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH handler already present"
+else
+    echo "[+] Injecting CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH handler"
+    # Anchor: after the CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT block from step 1
+    sed -i '/CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT)/,/+        }/ {
+        /+        }/ a\
++        if (cmd == CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH) {\
++            susfs_add_sus_kstat_redirect_batch(arg);\
++            return 0;\
++        }
+    }' "$KSU_PATCH"
+    ((inject_count++)) || true
+fi
+
+# Validate
+if ! grep -qw 'CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH' "$KSU_PATCH"; then
+    echo "FATAL: CMD_SUSFS_ADD_SUS_KSTAT_REDIRECT_BATCH handler injection failed"
+    exit 1
+fi
+
+# --- 4. open_redirect_all batch handler ---
+if grep -qw 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH' "$KSU_PATCH"; then
+    echo "[=] CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH handler already present"
+else
+    echo "[+] Injecting CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH handler"
+    # Anchor: after the CMD_SUSFS_ADD_OPEN_REDIRECT_ALL block from step 2
+    sed -i '/CMD_SUSFS_ADD_OPEN_REDIRECT_ALL)/,/+        }/ {
+        /+        }/ a\
++        if (cmd == CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH) {\
++            susfs_add_open_redirect_all_batch(arg);\
++            return 0;\
++        }
+    }' "$KSU_PATCH"
+    ((inject_count++)) || true
+fi
+
+# Validate
+if ! grep -qw 'CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH' "$KSU_PATCH"; then
+    echo "FATAL: CMD_SUSFS_ADD_OPEN_REDIRECT_ALL_BATCH handler injection failed"
+    exit 1
+fi
+
 echo "=== Done: $inject_count injections applied ==="
@@ -1,7 +1,8 @@
 #!/bin/bash
 # inject-susfs-unicode-filter-func.sh
-# Injects the susfs_check_unicode_bypass() function body and its declaration
-# into upstream SUSFS source, guarded by CONFIG_KSU_SUSFS_UNICODE_FILTER.
+# Injects the susfs_check_unicode_bypass() and susfs_check_unicode_bypass_name()
+# function bodies and their declarations into upstream SUSFS source, guarded
+# by CONFIG_KSU_SUSFS_UNICODE_FILTER.
 #
 # Usage: ./inject-susfs-unicode-filter-func.sh <SUSFS_KERNEL_PATCHES_DIR>
 
@@ -54,80 +55,122 @@ else
 \
 #ifdef CONFIG_KSU_SUSFS_UNICODE_FILTER\
 \
-static const unsigned char PAT_RTL_OVERRIDE[]   = {0xE2, 0x80, 0xAE};\
-static const unsigned char PAT_LTR_OVERRIDE[]   = {0xE2, 0x80, 0xAD};\
-static const unsigned char PAT_RTL_EMBED[]      = {0xE2, 0x80, 0xAB};\
-static const unsigned char PAT_LTR_EMBED[]      = {0xE2, 0x80, 0xAA};\
-static const unsigned char PAT_ZWSP[]           = {0xE2, 0x80, 0x8B};\
-static const unsigned char PAT_ZWNJ[]           = {0xE2, 0x80, 0x8C};\
-static const unsigned char PAT_ZWJ[]            = {0xE2, 0x80, 0x8D};\
-static const unsigned char PAT_BOM[]            = {0xEF, 0xBB, 0xBF};\
+/*\
+ * The verdict only needs one bit: any byte >= 0x80 is blocked. ASCII names\
+ * are cleared a word at a time; the offending sequence is decoded afterwards\
+ * just to say why in the log.\
+ */\
+struct susfs_unicode_range {\
+\tu32 lo, hi;\
+\tconst char *what;\
+};\
 \
-bool susfs_check_unicode_bypass(const char __user *filename)\
+static const struct susfs_unicode_range susfs_unicode_ranges[] = {\
+\t{ 0x0300, 0x036F, "diacritical" },\
+\t{ 0x0400, 0x047F, "cyrillic" },\
+\t{ 0x200B, 0x200D, "zero-width" },\
+\t{ 0x202A, 0x202E, "bidi control" },\
+\t{ 0xFEFF, 0xFEFF, "bom" },\
+};\
+\
+/* UTF-8 sequence length by lead byte high nibble, 0 = not a lead byte */\
+static const unsigned char susfs_utf8_len[16] = {\
+\t1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 2, 2, 3, 4,\
+};\
+\
+static const char *susfs_unicode_classify(const unsigned char *s, size_t len)\
+{\
+\tunsigned int n = susfs_utf8_len[s[0] >> 4];\
+\tu32 cp;\
+\tsize_t i;\
+\
+\tif (n < 2 || n > len)\
+\t\treturn "invalid utf-8";\
+\tcp = s[0] & (0x7F >> n);\
+\tfor (i = 1; i < n; i++) {\
+\t\tif ((s[i] & 0xC0) != 0x80)\
+\t\t\treturn "invalid utf-8";\
+\t\tcp = (cp << 6) | (s[i] & 0x3F);\
+\t}\
+\tfor (i = 0; i < ARRAY_SIZE(susfs_unicode_ranges); i++) {\
+\t\tif (cp >= susfs_unicode_ranges[i].lo && cp <= susfs_unicode_ranges[i].hi)\
+\t\t\treturn susfs_unicode_ranges[i].what;\
+\t}\
+\treturn "non-ascii";\
+}\
+\
+/* Offset of the first byte >= 0x80, or len */\
+static size_t susfs_first_non_ascii(const char *s, size_t len)\
+{\
+\tunsigned long w;\
+\tsize_t i = 0;\
+\
+\tfor (; i + sizeof(w) <= len; i += sizeof(w)) {\
+\t\tmemcpy(&w, s + i, sizeof(w));\
+\t\tif (w & REPEAT_BYTE(0x80))\
+\t\t\tbreak;\
+\t}\
+\tfor (; i < len; i++) {\
+\t\tif ((unsigned char)s[i] & 0x80)\
+\t\t\treturn i;\
+\t}\
+\treturn len;\
+}\
+\
+static bool susfs_unicode_blocked(const char *s, size_t len, unsigned int uid)\
+{\
+\tsize_t i = susfs_first_non_ascii(s, len);\
+\
+\tif (i == len)\
+\t\treturn false;\
+\tSUSFS_LOGI("unicode: blocked %s byte 0x%02x uid=%u\\n",\
+\t\t   susfs_unicode_classify((const unsigned char *)s + i, len - i),\
+\t\t   (unsigned char)s[i], uid);\
+\treturn true;\
+}\
+\
+/* For hooks that already hold the getname() copy: no allocation, no user access */\
+bool susfs_check_unicode_bypass_name(const struct filename *name)\
 {\
-\tchar *buf;\
 \tunsigned int uid;\
-\tbool blocked = false;\
-\tlong len;\
-\tint i;\
 \
-\tif (!filename)\
+\tif (IS_ERR_OR_NULL(name) || !name->name)\
+\t\treturn false;\
+\tif (susfs_is_name_zeromount_ascii(name))\
 \t\treturn false;\
 \
 \tuid = current_uid().val;\
 \tif (uid == 0 || uid == 1000)\
 \t\treturn false;\
 \
-\tbuf = kmalloc(PATH_MAX, GFP_KERNEL);\
-\tif (!buf)\
+\treturn susfs_unicode_blocked(name->name, strlen(name->name), uid);\
+}\
+\
+bool susfs_check_unicode_bypass(const char __user *filename)\
+{\
+\tchar chunk[128];\
+\tunsigned int uid;\
+\tlong off = 0, len;\
+\
+\tif (!filename)\
 \t\treturn false;\
 \
-\tlen = strncpy_from_user(buf, filename, PATH_MAX - 1);\
-\tif (len <= 0) {\
-\t\tkfree(buf);\
+\tuid = current_uid().val;\
+\tif (uid == 0 || uid == 1000)\
 \t\treturn false;\
-\t}\
-\tbuf[len] = '"'"'\\0'"'"';\
-\
-\tfor (i = 0; i < len; i++) {\
-\t\tunsigned char c = (unsigned char)buf[i];\
-\
-\t\tif (c <= 127)\
-\t\t\tcontinue;\
-\
-\t\tif (i + 2 < len) {\
-\t\t\tif (memcmp(&buf[i], PAT_RTL_OVERRIDE, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_LTR_OVERRIDE, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_RTL_EMBED, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_LTR_EMBED, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_ZWSP, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_ZWNJ, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_ZWJ, 3) == 0 ||\
-\t\t\t    memcmp(&buf[i], PAT_BOM, 3) == 0) {\
-\t\t\t\tSUSFS_LOGI("unicode: blocked pattern uid=%u\\n", uid);\
-\t\t\t\tblocked = true;\
-\t\t\t\tbreak;\
-\t\t\t}\
-\t\t}\
-\
-\t\tif (c == 0xD0 || c == 0xD1) {\
-\t\t\tSUSFS_LOGI("unicode: blocked cyrillic uid=%u\\n", uid);\
-\t\t\tblocked = true;\
-\t\t\tbreak;\
-\t\t}\
 \
-\t\tif (c == 0xCC || (c == 0xCD && i + 1 < len && (unsigned char)buf[i+1] <= 0xAF)) {\
-\t\t\tSUSFS_LOGI("unicode: blocked diacritical uid=%u\\n", uid);\
-\t\t\tblocked = true;\
+\t// Scan in stack-sized pieces; nearly every path fits in the first one\
+\twhile (off < PATH_MAX) {\
+\t\tlen = strncpy_from_user(chunk, filename + off, sizeof(chunk));\
+\t\tif (len <= 0)\
+\t\t\treturn false;\
+\t\tif (susfs_unicode_blocked(chunk, len, uid))\
+\t\t\treturn true;\
+\t\tif (len < (long)sizeof(chunk))\
 \t\t\tbreak;\
-\t\t}\
-\
-\t\tSUSFS_LOGI("unicode: blocked byte 0x%02x uid=%u\\n", c, uid);\
-\t\tblocked = true;\
-\t\tbreak;\
+\t\toff += len;\
 \t}\
-\tkfree(buf);\
-\treturn blocked;\
+\treturn false;\
 }\
 #endif
     }' "$SUSFS_C"
@@ -149,7 +192,9 @@ else
     sed -i '/^void susfs_init(void);/a \
 \
 #ifdef CONFIG_KSU_SUSFS_UNICODE_FILTER\
+struct filename;\
 bool susfs_check_unicode_bypass(const char __user *filename);\
+bool susfs_check_unicode_bypass_name(const struct filename *name);\
 #endif' "$SUSFS_H"
     ((inject_count++)) || true
 fi
@@ -44,12 +44,12 @@ if grep -q 'susfs_get_redirected_path_all' "$NAMEI"; then
     echo "[=] susfs_get_redirected_path_all extern already present"
 else
     echo "[+] Injecting susfs_get_redirected_path_all extern"
-    sed -i '/^extern struct filename\* susfs_get_redirected_path(unsigned long ino);/a extern struct filename* susfs_get_redirected_path_all(unsigned long ino);' "$NAMEI"
+    sed -i '/^extern struct filename\* susfs_get_redirected_path(unsigned long ino);/a struct st_susfs_open_redirect_all_hlist;\nextern struct filename* susfs_get_redirected_path_all(struct inode *inode, struct st_susfs_open_redirect_all_hlist **ref);\nextern void susfs_put_redirected_path_all(struct filename *name, struct st_susfs_open_redirect_all_hlist *ref);' "$NAMEI"
     ((inject_count++)) || true
 fi
 
 # --- 2. Replace single-check redirect with two-branch (ALL first, then per-UID) ---
-if grep -q 'susfs_get_redirected_path_all.*i_ino' "$NAMEI"; then
+if grep -q 'susfs_get_redirected_path_all(filp->f_inode' "$NAMEI"; then
     echo "[=] OPEN_REDIRECT_ALL two-branch check already present in do_filp_open"
 else
     echo "[+] Replacing do_filp_open redirect block with two-branch check"
@@ -75,7 +75,9 @@ else
             print "#ifdef CONFIG_KSU_SUSFS_OPEN_REDIRECT"
             print "\tif (!IS_ERR(filp)) {"
             print "\t\tif (unlikely(test_bit(AS_FLAGS_OPEN_REDIRECT_ALL, &filp->f_inode->i_mapping->flags))) {"
-            print "\t\t\tfake_pathname = susfs_get_redirected_path_all(filp->f_inode->i_ino);"
+            print "\t\t\tstruct st_susfs_open_redirect_all_hlist *redirect_ref;"
+            print ""
+            print "\t\t\tfake_pathname = susfs_get_redirected_path_all(filp->f_inode, &redirect_ref);"
             print "\t\t\tif (!IS_ERR(fake_pathname)) {"
             print "\t\t\t\trestore_nameidata();"
             print "\t\t\t\tfilp_close(filp, NULL);"
@@ -86,7 +88,7 @@ else
             print "\t\t\t\tif (unlikely(filp == ERR_PTR(-ESTALE)))"
             print "\t\t\t\t\tfilp = path_openat(&nd, op, flags | LOOKUP_REVAL);"
             print "\t\t\t\trestore_nameidata();"
-            print "\t\t\t\tputname(fake_pathname);"
+            print "\t\t\t\tsusfs_put_redirected_path_all(fake_pathname, redirect_ref);"
             print "\t\t\t\treturn filp;"
             print "\t\t\t}"
             print "\t\t} else if (unlikely(test_bit(AS_FLAGS_OPEN_REDIRECT, &filp->f_inode->i_mapping->flags)) &&"
@@ -1,8 +1,9 @@
 #!/bin/bash
 # inject-susfs-zeromount-coupling.sh
 # Injects zeromount_is_uid_blocked extern and susfs_is_uid_zeromount_excluded
-# inline wrapper into susfs_def.h, and modifies is_i_uid_not_allowed in susfs.c
-# to add zeromount exclusion.
+# inline wrapper into susfs_def.h, the susfs_is_name_zeromount_ascii wrapper
+# over ZeroMount's per-name getname_flags() classification, and modifies
+# is_i_uid_not_allowed in susfs.c to add zeromount exclusion.
 #
 # Usage: ./inject-susfs-zeromount-coupling.sh <SUSFS_KERNEL_PATCHES_DIR>
 
@@ -54,7 +55,34 @@ if ! grep -q 'zeromount_is_uid_blocked' "$SUSFS_DEF_H"; then
     exit 1
 fi
 
-# --- 2. Modify is_i_uid_not_allowed() in susfs.c ---
+# --- 2. Shared name classification wrapper in susfs_def.h ---
+# ZeroMount classifies every getname_flags() result once; hooks that receive
+# the resulting struct filename read the verdict instead of re-copying the
+# user string.
+if grep -q 'zeromount_name_class' "$SUSFS_DEF_H"; then
+    echo "[=] zeromount name classification wrapper already present in susfs_def.h"
+else
+    echo "[+] Injecting zeromount name classification wrapper into susfs_def.h"
+    sed -i '/^#endif.*KSU_SUSFS_DEF_H/ i\
+\/\/ ZeroMount getname_flags() verdict for a struct filename; false = unknown\
+#ifdef CONFIG_ZEROMOUNT\
+#include <linux/zeromount.h>\
+static inline bool susfs_is_name_zeromount_ascii(const struct filename *name) {\
+\treturn zeromount_name_class(name) \& ZM_CLASS_ASCII;\
+}\
+#else\
+struct filename;\
+static inline bool susfs_is_name_zeromount_ascii(const struct filename *name) { return false; }\
+#endif' "$SUSFS_DEF_H"
+    ((inject_count++)) || true
+fi
+
+if ! grep -q 'susfs_is_name_zeromount_ascii' "$SUSFS_DEF_H"; then
+    echo "FATAL: zeromount name classification injection failed in susfs_def.h"
+    exit 1
+fi
+
+# --- 3. Modify is_i_uid_not_allowed() in susfs.c ---
 # Upstream dev consolidated the 3 uid-check functions into just is_i_uid_not_allowed.
 if grep -q 'susfs_is_uid_zeromount_excluded' "$SUSFS_C"; then
     echo "[=] zeromount checks already present in susfs.c"
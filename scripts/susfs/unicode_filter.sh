@@ -1,6 +1,10 @@
 #!/bin/bash
 # CVE-2024-43093 unicode path traversal mitigation
 # Injects susfs_check_unicode_bypass() at VFS entry points
+#
+# Hooks that already hold a struct filename use the _name variant, which
+# scans the getname() copy in place (and trusts ZeroMount's ASCII verdict
+# when present) instead of copying the user string a second time.
 
 set -e
 cd "${1:-.}" || exit 1
@@ -43,7 +47,7 @@ patch_namei() {
         sed -i '/unsigned int lookup_flags = LOOKUP_DIRECTORY;/a\
 \
 #ifdef CONFIG_KSU_SUSFS_UNICODE_FILTER\
-	if (susfs_check_unicode_bypass(name->uptr)) {\
+	if (susfs_check_unicode_bypass_name(name)) {\
 		return -ENOENT;\
 	}\
 #endif' "$f"
@@ -74,7 +78,7 @@ patch_namei() {
             /unsigned int lookup_flags = 0;/a\
 \
 #ifdef CONFIG_KSU_SUSFS_UNICODE_FILTER\
-	if (susfs_check_unicode_bypass(to->uptr)) {\
+	if (susfs_check_unicode_bypass_name(to)) {\
 		return -ENOENT;\
 	}\
 #endif
@@ -97,7 +101,7 @@ patch_namei() {
             /int error;$/a\
 \
 #ifdef CONFIG_KSU_SUSFS_UNICODE_FILTER\
-	if (susfs_check_unicode_bypass(new->uptr)) {\
+	if (susfs_check_unicode_bypass_name(new)) {\
 		return -ENOENT;\
 	}\
 #endif
@@ -171,7 +175,7 @@ patch_stat() {
             /int error;$/a\
 \
 #ifdef CONFIG_KSU_SUSFS_UNICODE_FILTER\
-	if (susfs_check_unicode_bypass(filename->uptr)) {\
+	if (susfs_check_unicode_bypass_name(filename)) {\
 		return -ENOENT;\
 	}\
 #endif
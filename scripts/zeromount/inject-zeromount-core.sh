@@ -4,6 +4,7 @@
 # Replaces the context-sensitive zeromount-core.patch hunks for fs/Kconfig and fs/Makefile
 # with scripted insertion that works across 5.10, 5.15, 6.1, 6.6 regardless of line numbers.
 # New files (zeromount.c, zeromount.h) are copied directly since they have no context deps.
+# struct filename gains a zm_class field for the per-name getname_flags() verdict.
 #
 # Usage: ./inject-zeromount-core.sh <kernel-source-root>
 
@@ -29,9 +30,9 @@ echo "Injecting ZeroMount core into: $KERNEL_ROOT"
 KCONFIG="$KERNEL_ROOT/fs/Kconfig"
 
 if grep -q 'config ZEROMOUNT' "$KCONFIG"; then
-    echo "  [1/4] Kconfig already has ZEROMOUNT. Skipping."
+    echo "  [1/5] Kconfig already has ZEROMOUNT. Skipping."
 else
-    echo "  [1/4] Adding CONFIG_ZEROMOUNT to fs/Kconfig..."
+    echo "  [1/5] Adding CONFIG_ZEROMOUNT to fs/Kconfig..."
 
     # Insert the config block before the last 'endmenu' in fs/Kconfig.
     # tac/reverse approach: find the LAST endmenu, insert before it.
@@ -64,9 +65,9 @@ fi
 MAKEFILE="$KERNEL_ROOT/fs/Makefile"
 
 if grep -q 'CONFIG_ZEROMOUNT' "$MAKEFILE"; then
-    echo "  [2/4] Makefile already has CONFIG_ZEROMOUNT. Skipping."
+    echo "  [2/5] Makefile already has CONFIG_ZEROMOUNT. Skipping."
 else
-    echo "  [2/4] Adding zeromount.o to fs/Makefile..."
+    echo "  [2/5] Adding zeromount.o to fs/Makefile..."
 
     # Append to end — no context dependency at all
     echo 'obj-$(CONFIG_ZEROMOUNT) += zeromount.o' >> "$MAKEFILE"
@@ -83,9 +84,9 @@ ZEROMOUNT_C="$KERNEL_ROOT/fs/zeromount.c"
 ZEROMOUNT_C_SRC="$SCRIPT_DIR/src/zeromount.c"
 
 if [ -f "$ZEROMOUNT_C" ]; then
-    echo "  [3/4] fs/zeromount.c already exists. Skipping."
+    echo "  [3/5] fs/zeromount.c already exists. Skipping."
 else
-    echo "  [3/4] Installing fs/zeromount.c..."
+    echo "  [3/5] Installing fs/zeromount.c..."
     if [ ! -f "$ZEROMOUNT_C_SRC" ]; then
         echo "Error: Source file not found: $ZEROMOUNT_C_SRC"
         exit 1
@@ -99,9 +100,9 @@ ZEROMOUNT_H="$KERNEL_ROOT/include/linux/zeromount.h"
 ZEROMOUNT_H_SRC="$SCRIPT_DIR/src/zeromount.h"
 
 if [ -f "$ZEROMOUNT_H" ]; then
-    echo "  [4/4] include/linux/zeromount.h already exists. Skipping."
+    echo "  [4/5] include/linux/zeromount.h already exists. Skipping."
 else
-    echo "  [4/4] Installing include/linux/zeromount.h..."
+    echo "  [4/5] Installing include/linux/zeromount.h..."
     if [ ! -f "$ZEROMOUNT_H_SRC" ]; then
         echo "Error: Source file not found: $ZEROMOUNT_H_SRC"
         exit 1
@@ -109,4 +110,29 @@ else
     cp "$ZEROMOUNT_H_SRC" "$ZEROMOUNT_H"
 fi
 
+# --- 5. include/linux/fs.h: per-name classification in struct filename ---
+# zm_class sits right after refcnt (int or atomic_t), in the padding before
+# the aname pointer, so the struct does not grow and iname stays aligned.
+# __GENKSYMS__ hides it from symbol versioning, so exported functions taking
+# a struct filename keep their CRCs and the GKI KMI is unchanged.
+
+FS_H="$KERNEL_ROOT/include/linux/fs.h"
+
+if grep -q 'zm_class' "$FS_H"; then
+    echo "  [5/5] struct filename already has zm_class. Skipping."
+else
+    echo "  [5/5] Adding zm_class to struct filename..."
+    sed -i '/^struct filename {/,/^};/{
+/^[[:space:]]*\(int\|atomic_t\)[[:space:]]\+refcnt;/a\
+#if defined(CONFIG_ZEROMOUNT) \&\& !defined(__GENKSYMS__)\
+\tunsigned int\t\tzm_class;\t/* zeromount_name_class() verdict */\
+#endif
+}' "$FS_H"
+
+    if ! grep -q 'zm_class' "$FS_H"; then
+        echo "Error: Failed to add zm_class to struct filename"
+        exit 1
+    fi
+fi
+
 echo "ZeroMount core injection complete."
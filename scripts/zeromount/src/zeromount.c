@@ -21,6 +21,9 @@
 #include <linux/statfs.h>
 #include <linux/file.h>
 #include <linux/fs_struct.h>
+#include <linux/workqueue.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
 #ifdef CONFIG_KSU_SUSFS
 #include <linux/susfs.h>
 #endif
@@ -48,13 +51,13 @@ static void zeromount_bloom_add(const char *name)
     set_bit(h2 & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom);
 }
 
-static bool zeromount_bloom_test(const char *name)
+static bool zeromount_bloom_test_len(const char *name, size_t len)
 {
-    unsigned int len = strlen(name);
     unsigned int h1 = jhash(name, len, 0);
-    unsigned int h2 = jhash(name, len, 1);
+    unsigned int h2;
     if (!test_bit(h1 & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom))
         return false;
+    h2 = jhash(name, len, 1);
     if (!test_bit(h2 & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom))
         return false;
     return true;
@@ -142,6 +145,75 @@ bool zeromount_match_path(const char *input_path, const char *rule_path) {
     return false;
 }
 
+/*
+ * Per-name classification, computed once in getname_flags() and read back by
+ * SUSFS hooks that see the same struct filename. The verdict lives in the
+ * zm_class field inject-zeromount-core.sh adds to struct filename, so it
+ * travels with the name. getname_kernel() names have no uptr and their
+ * zm_class is never initialized, so they always read as unclassified.
+ */
+unsigned int zeromount_name_class(const struct filename *name)
+{
+    if (!name || !name->uptr)
+        return 0;
+    return name->zm_class;
+}
+EXPORT_SYMBOL(zeromount_name_class); /* extern in susfs_def.h via the coupling script */
+
+// Length and 7-bit cleanliness in a single pass over the name
+static size_t zeromount_scan_name(const char *name, bool *ascii)
+{
+    const char *p = name;
+    unsigned char acc = 0;
+
+    while (*p)
+        acc |= *p++;
+    *ascii = !(acc & 0x80);
+    return p - name;
+}
+
+/* Same rules as zeromount_normalize_path(), as a view into the input */
+static const char *zeromount_normalize_view(const char *path, size_t len, size_t *out_len)
+{
+    const char *p = path;
+
+    if (len >= 8 && memcmp(path, "/system/", 8) == 0) {
+        p += 7;
+        len -= 7;
+    }
+
+    while (len > 1 && p[len - 1] == '/')
+        len--;
+
+    *out_len = len;
+    return p;
+}
+
+// Returns a copy of the real path for a normalized virtual path, or NULL
+static char *zeromount_lookup_target(const char *path, size_t len)
+{
+    struct zeromount_rule *rule;
+    char *target = NULL;
+    u32 hash;
+
+    if (!zeromount_bloom_test_len(path, len))
+        return NULL;
+
+    hash = full_name_hash(NULL, path, len);
+
+    rcu_read_lock();
+    hash_for_each_possible_rcu(zeromount_rules_ht, rule, node, hash) {
+        if (rule->vp_len != len || memcmp(rule->virtual_path, path, len) != 0)
+            continue;
+        if (rule->flags & ZM_FLAG_ACTIVE) {
+            target = kstrdup(rule->real_path, GFP_ATOMIC);
+            break;
+        }
+    }
+    rcu_read_unlock();
+    return target;
+}
+
 static char *zeromount_normalize_path(const char *path)
 {
     char *normalized;
@@ -170,9 +242,35 @@ static char *zeromount_normalize_path(const char *path)
     return normalized;
 }
 
+/*
+ * A loaded rule image: the validated blob plus the rule, dir and child
+ * arrays adopted from it, all in one allocation. Every linked rule and dir
+ * node holds a reference; the last RCU free releases the whole thing.
+ */
+struct zeromount_image {
+    atomic_t users;
+    void *blob;
+    struct zeromount_rule *rules;
+    struct zeromount_dir_node *dirs;
+    struct zeromount_child_name *children;
+};
+
+static void zeromount_image_put(struct zeromount_image *img)
+{
+    if (atomic_dec_and_test(&img->users)) {
+        kvfree(img->blob);
+        kvfree(img);
+    }
+}
+
 static void zeromount_free_rule_rcu(struct rcu_head *head)
 {
     struct zeromount_rule *rule = container_of(head, struct zeromount_rule, rcu);
+
+    if (rule->image) {
+        zeromount_image_put(rule->image);
+        return;
+    }
     kfree(rule->virtual_path);
     kfree(rule->real_path);
     kfree(rule);
@@ -185,9 +283,15 @@ static void zeromount_free_dir_node_rcu(struct rcu_head *head)
 
     list_for_each_entry_safe(child, ctmp, &dn->children_names, list) {
         list_del(&child->list);
+        if (child->in_image)
+            continue;
         kfree(child->name);
         kfree(child);
     }
+    if (dn->image) {
+        zeromount_image_put(dn->image);
+        return;
+    }
     kfree(dn->dir_path);
     kfree(dn);
 }
@@ -247,40 +351,245 @@ static void zeromount_flush_dcache(const char *path_name)
 	zm_exit();
 }
 
+/*
+ * Parallel dcache refresh: rules are snapshotted, sorted so siblings sit next
+ * to each other, and every parent directory is walked once. Children are
+ * invalidated straight from the dcache, so uncached names cost nothing.
+ */
+#define ZM_REFRESH_MAX_WORKERS 8
+#define ZM_REFRESH_MIN_BATCH   64
+
+static struct workqueue_struct *zeromount_refresh_wq;
+static u64 zm_refresh_last_ns;
+static int zm_refresh_last_rules;
+static int zm_refresh_last_parents;
+
+struct zeromount_refresh_ent {
+    const char *path;
+    u32 len;
+    u32 parent_len; /* offset of the last '/', 0 for children of "/" */
+};
+
+struct zeromount_refresh_ctx {
+    struct zeromount_refresh_ent *ents;
+    struct path root;
+    const struct cred *cred; /* caller's creds, applied in every worker */
+    atomic_t nr_parents;
+};
+
+struct zeromount_parallel_work {
+    struct work_struct work;
+    void (*fn)(void *ctx, int start, int end);
+    void *ctx;
+    int start;
+    int end;
+};
+
+static void zeromount_parallel_work_fn(struct work_struct *work)
+{
+    struct zeromount_parallel_work *pw =
+        container_of(work, struct zeromount_parallel_work, work);
+
+    pw->fn(pw->ctx, pw->start, pw->end);
+}
+
+/*
+ * Run fn over [0, n) in up to ZM_REFRESH_MAX_WORKERS ranges on the bounded
+ * refresh workqueue and wait for all of them. can_split(ctx, i) says whether
+ * a range may end right before item i, so related items stay together.
+ */
+static void zeromount_parallel_for(int n, void (*fn)(void *ctx, int start, int end),
+                                   bool (*can_split)(void *ctx, int idx), void *ctx)
+{
+    struct zeromount_parallel_work works[ZM_REFRESH_MAX_WORKERS];
+    int nr_workers, chunk, start = 0, nr = 0, i;
+
+    nr_workers = min_t(int, num_online_cpus(), ZM_REFRESH_MAX_WORKERS);
+    if (!zeromount_refresh_wq || nr_workers <= 1 || n < ZM_REFRESH_MIN_BATCH) {
+        fn(ctx, 0, n);
+        return;
+    }
+
+    chunk = DIV_ROUND_UP(n, nr_workers);
+    while (start < n && nr < ZM_REFRESH_MAX_WORKERS) {
+        int end = min(start + chunk, n);
+
+        while (end < n && can_split && !can_split(ctx, end))
+            end++;
+
+        works[nr].fn = fn;
+        works[nr].ctx = ctx;
+        works[nr].start = start;
+        works[nr].end = end;
+        INIT_WORK_ONSTACK(&works[nr].work, zeromount_parallel_work_fn);
+        queue_work(zeromount_refresh_wq, &works[nr].work);
+        nr++;
+        start = end;
+    }
+
+    for (i = 0; i < nr; i++) {
+        flush_work(&works[i].work);
+        destroy_work_on_stack(&works[i].work);
+    }
+}
+
+static int zeromount_refresh_cmp(const void *a, const void *b)
+{
+    const struct zeromount_refresh_ent *x = a, *y = b;
+    int ret;
+
+    ret = memcmp(x->path, y->path, min(x->parent_len, y->parent_len));
+    if (ret)
+        return ret;
+    if (x->parent_len != y->parent_len)
+        return x->parent_len < y->parent_len ? -1 : 1;
+    return strcmp(x->path + x->parent_len, y->path + y->parent_len);
+}
+
+static inline bool zeromount_refresh_same_parent(const struct zeromount_refresh_ent *a,
+                                                 const struct zeromount_refresh_ent *b)
+{
+    return a->parent_len == b->parent_len &&
+           memcmp(a->path, b->path, a->parent_len) == 0;
+}
+
+static bool zeromount_refresh_can_split(void *data, int idx)
+{
+    struct zeromount_refresh_ctx *ctx = data;
+
+    return !zeromount_refresh_same_parent(&ctx->ents[idx], &ctx->ents[idx - 1]);
+}
+
+static void zeromount_invalidate_child(struct dentry *parent, const char *name, u32 len)
+{
+    struct qstr q = QSTR_INIT(name, len);
+    struct dentry *child;
+
+    // dcache-only probe: nothing cached means nothing stale
+    child = d_hash_and_lookup(parent, &q);
+    if (IS_ERR_OR_NULL(child))
+        return;
+
+    d_invalidate(child);
+    d_drop(child);
+    dput(child);
+}
+
+static void zeromount_refresh_range(void *data, int start, int end)
+{
+    struct zeromount_refresh_ctx *ctx = data;
+    const struct cred *old_cred;
+    struct path parent;
+    bool have_parent = false;
+    char *buf;
+    int i;
+
+    buf = __getname();
+    if (!buf)
+        return;
+
+    // Workers run with kworker creds; look up as the caller would
+    old_cred = override_creds(ctx->cred);
+    zm_enter();
+    for (i = start; i < end; i++) {
+        struct zeromount_refresh_ent *e = &ctx->ents[i];
+
+        if (i == start || !zeromount_refresh_same_parent(e, e - 1)) {
+            if (have_parent)
+                path_put(&parent);
+            have_parent = false;
+
+            if (e->parent_len == 0) {
+                buf[0] = '/';
+                buf[1] = '\0';
+            } else {
+                memcpy(buf, e->path, e->parent_len);
+                buf[e->parent_len] = '\0';
+            }
+
+            if (vfs_path_lookup(ctx->root.dentry, ctx->root.mnt, buf,
+                                LOOKUP_FOLLOW | LOOKUP_DIRECTORY, &parent) == 0) {
+                have_parent = true;
+                atomic_inc(&ctx->nr_parents);
+            }
+        } else if (e->len == e[-1].len && memcmp(e->path, e[-1].path, e->len) == 0) {
+            continue;
+        }
+
+        if (have_parent)
+            zeromount_invalidate_child(parent.dentry, e->path + e->parent_len + 1,
+                                       e->len - e->parent_len - 1);
+    }
+    if (have_parent)
+        path_put(&parent);
+    zm_exit();
+    revert_creds(old_cred);
+
+    __putname(buf);
+}
+
 static void zeromount_force_refresh_all(void)
 {
-	struct zeromount_rule *rule;
-	char **paths = NULL;
-	int count = 0, i = 0;
-
-	spin_lock(&zeromount_lock);
-	list_for_each_entry(rule, &zeromount_rules_list, list)
-		count++;
-	spin_unlock(&zeromount_lock);
-
-	if (count == 0)
-		return;
-
-	paths = kvmalloc_array(count, sizeof(char *), GFP_KERNEL);
-	if (!paths)
-		return;
-
-	spin_lock(&zeromount_lock);
-	list_for_each_entry(rule, &zeromount_rules_list, list) {
-		if (i >= count)
-			break;
-		paths[i] = kstrdup(rule->virtual_path, GFP_ATOMIC);
-		if (!paths[i])
-			break;
-		i++;
-	}
-	spin_unlock(&zeromount_lock);
+    struct zeromount_refresh_ctx ctx;
+    struct zeromount_rule *rule;
+    size_t bytes = 0, used = 0;
+    char *strs;
+    int count = 0, i = 0;
+    u64 start_ns = ktime_get_ns();
 
-	for (count = i, i = 0; i < count; i++) {
-		zeromount_flush_dcache(paths[i]);
-		kfree(paths[i]);
-	}
-	kvfree(paths);
+    spin_lock(&zeromount_lock);
+    list_for_each_entry(rule, &zeromount_rules_list, list) {
+        count++;
+        bytes += rule->vp_len + 1;
+    }
+    spin_unlock(&zeromount_lock);
+
+    if (count == 0)
+        return;
+
+    // One buffer for entries and strings: nothing is allocated under the lock
+    ctx.ents = kvmalloc(array_size(count, sizeof(*ctx.ents)) + bytes, GFP_KERNEL);
+    if (!ctx.ents)
+        return;
+    strs = (char *)(ctx.ents + count);
+
+    spin_lock(&zeromount_lock);
+    list_for_each_entry(rule, &zeromount_rules_list, list) {
+        const char *slash;
+
+        if (i >= count || used + rule->vp_len + 1 > bytes)
+            break;
+
+        slash = strrchr(rule->virtual_path, '/');
+        if (!slash || rule->vp_len < 2)
+            continue;
+
+        memcpy(strs + used, rule->virtual_path, rule->vp_len + 1);
+        ctx.ents[i].path = strs + used;
+        ctx.ents[i].len = rule->vp_len;
+        ctx.ents[i].parent_len = slash - rule->virtual_path;
+        used += rule->vp_len + 1;
+        i++;
+    }
+    spin_unlock(&zeromount_lock);
+    count = i;
+
+    sort(ctx.ents, count, sizeof(*ctx.ents), zeromount_refresh_cmp, NULL);
+
+    get_fs_root(current->fs, &ctx.root);
+    ctx.cred = get_current_cred();
+    atomic_set(&ctx.nr_parents, 0);
+    zeromount_parallel_for(count, zeromount_refresh_range,
+                           zeromount_refresh_can_split, &ctx);
+    put_cred(ctx.cred);
+    path_put(&ctx.root);
+    kvfree(ctx.ents);
+
+    WRITE_ONCE(zm_refresh_last_ns, ktime_get_ns() - start_ns);
+    WRITE_ONCE(zm_refresh_last_rules, count);
+    WRITE_ONCE(zm_refresh_last_parents, atomic_read(&ctx.nr_parents));
+    ZM_INFO("refresh: %d rules, %d parents, %llu us\n", count,
+            atomic_read(&ctx.nr_parents), div_u64(zm_refresh_last_ns, NSEC_PER_USEC));
 }
 
 static unsigned long zeromount_generate_ino(const char *dir, const char *name) {
@@ -384,38 +693,16 @@ EXPORT_SYMBOL(zeromount_is_injected_file);
 
 char *zeromount_resolve_path(const char *pathname)
 {
-    struct zeromount_rule *rule;
-    char *target = NULL;
-    char *normalized;
-    u32 hash;
+    const char *normalized;
+    size_t len;
 
     if (zeromount_is_critical_process())
         return NULL;
     if (ZEROMOUNT_DISABLED() || zeromount_is_uid_blocked(current_uid().val) || !pathname) return NULL;
 
     // Must normalize before hashing — rules are stored under normalized keys
-    normalized = zeromount_normalize_path(pathname);
-    if (!normalized) return NULL;
-
-    hash = full_name_hash(NULL, normalized, strlen(normalized));
-
-    if (!zeromount_bloom_test(normalized)) {
-        kfree(normalized);
-        return NULL;
-    }
-
-    rcu_read_lock();
-    hash_for_each_possible_rcu(zeromount_rules_ht, rule, node, hash) {
-        if (zeromount_match_path(normalized, rule->virtual_path)) {
-            if (rule->flags & ZM_FLAG_ACTIVE) {
-                target = kstrdup(rule->real_path, GFP_ATOMIC);
-                break;
-            }
-        }
-    }
-    rcu_read_unlock();
-    kfree(normalized);
-    return target;
+    normalized = zeromount_normalize_view(pathname, strlen(pathname), &len);
+    return zeromount_lookup_target(normalized, len);
 }
 EXPORT_SYMBOL(zeromount_resolve_path);
 
@@ -490,16 +777,32 @@ struct filename *zeromount_getname_hook(struct filename *name)
 {
     char *target_path;
     struct filename *new_name;
+    const char *normalized;
+    size_t len, norm_len;
+    bool ascii;
+
+    if (!name)
+        return name;
 
-    if (zeromount_should_skip() || zeromount_is_uid_blocked(current_uid().val) || !name || name->name[0] != '/')
+    // Every getname_flags() name leaves here with a defined verdict; when
+    // ZeroMount is idle that is "unclassified" and consumers check for real
+    name->zm_class = 0;
+    if (zeromount_should_skip())
         return name;
 
-    if (!zeromount_bloom_test(name->name))
+    len = zeromount_scan_name(name->name, &ascii);
+    name->zm_class = ZM_CLASS_VALID | (ascii ? ZM_CLASS_ASCII : 0);
+
+    if (name->name[0] != '/' || zeromount_is_uid_blocked(current_uid().val))
+        return name;
+
+    if (!zeromount_bloom_test_len(name->name, len))
         return name;
 
     zm_enter();
 
-    target_path = zeromount_resolve_path(name->name);
+    normalized = zeromount_normalize_view(name->name, len, &norm_len);
+    target_path = zeromount_lookup_target(normalized, norm_len);
     if (!target_path) {
         zm_exit();
         return name;
@@ -1032,16 +1335,14 @@ static int zeromount_ioctl_del_rule(unsigned long arg)
     return found ? 0 : -ENOENT;
 }
 
-static int zeromount_ioctl_clear_rules(void)
+/* Caller holds zeromount_lock */
+static void zeromount_unlink_rules_and_dirs(void)
 {
     struct zeromount_rule *rule;
-    struct zeromount_uid_node *uid_node;
     struct zeromount_dir_node *dir_node;
     struct hlist_node *tmp;
     int bkt;
 
-    spin_lock(&zeromount_lock);
-
     hash_for_each_safe(zeromount_rules_ht, bkt, tmp, rule, node) {
         hash_del_rcu(&rule->node);
         if (rule->real_ino != 0)
@@ -1050,23 +1351,294 @@ static int zeromount_ioctl_clear_rules(void)
         call_rcu(&rule->rcu, zeromount_free_rule_rcu);
     }
 
-    hash_for_each_safe(zeromount_uid_ht, bkt, tmp, uid_node, node) {
-        hash_del_rcu(&uid_node->node);
-        kfree_rcu(uid_node, rcu);
-    }
-
     hash_for_each_safe(zeromount_dirs_ht, bkt, tmp, dir_node, node) {
         hash_del_rcu(&dir_node->node);
         call_rcu(&dir_node->rcu, zeromount_free_dir_node_rcu);
     }
 
     bitmap_zero(zeromount_bloom, ZEROMOUNT_BLOOM_SIZE);
+}
+
+static int zeromount_ioctl_clear_rules(void)
+{
+    struct zeromount_uid_node *uid_node;
+    struct hlist_node *tmp;
+    int bkt;
+
+    spin_lock(&zeromount_lock);
+
+    zeromount_unlink_rules_and_dirs();
+
+    hash_for_each_safe(zeromount_uid_ht, bkt, tmp, uid_node, node) {
+        hash_del_rcu(&uid_node->node);
+        kfree_rcu(uid_node, rcu);
+    }
 
     spin_unlock(&zeromount_lock);
     ZM_DBG("clear_rules: all rules, uids, and dirs cleared\n");
     return 0;
 }
 
+/*
+ * ZEROMOUNT_IOC_LOAD_IMAGE: the boot-time counterpart of a long ADD_RULE
+ * sequence. Userspace compiles the ruleset once (see zeromount.h); here it is
+ * copied in with a single allocation, validated, adopted in place and
+ * published under one lock hold. Strings are never duplicated and the only
+ * per-rule filesystem work left is resolving the real inode, which runs on
+ * the refresh workers.
+ */
+static const char *zeromount_image_str(const struct zeromount_img_header *hdr,
+                                       const char *strtab, u32 off, u32 len)
+{
+    if (off >= hdr->strtab_size || len >= hdr->strtab_size - off)
+        return NULL;
+    if (strtab[off + len] != '\0' || memchr(strtab + off, '\0', len))
+        return NULL;
+    return strtab + off;
+}
+
+static bool zeromount_image_section_ok(const struct zeromount_img_header *hdr,
+                                       u32 off, u32 nr, size_t entsize)
+{
+    if (off % 4 || off < sizeof(*hdr) || off > hdr->size)
+        return false;
+    return (u64)nr * entsize <= hdr->size - off;
+}
+
+static int zeromount_image_validate(const void *blob, size_t size)
+{
+    const struct zeromount_img_header *hdr = blob;
+    const struct zeromount_img_rule *rules;
+    const struct zeromount_img_dir *dirs;
+    const struct zeromount_img_child *children;
+    const char *strtab, *prev = NULL;
+    u32 i, j, next_child = 0;
+
+    if (size < sizeof(*hdr))
+        return -EINVAL;
+    if (hdr->magic != ZEROMOUNT_IMG_MAGIC || hdr->version != ZEROMOUNT_IMG_VERSION ||
+        hdr->size != size)
+        return -EINVAL;
+
+    if (!zeromount_image_section_ok(hdr, hdr->rules_off, hdr->nr_rules, sizeof(*rules)) ||
+        !zeromount_image_section_ok(hdr, hdr->dirs_off, hdr->nr_dirs, sizeof(*dirs)) ||
+        !zeromount_image_section_ok(hdr, hdr->children_off, hdr->nr_children, sizeof(*children)) ||
+        !zeromount_image_section_ok(hdr, hdr->strtab_off, hdr->strtab_size, 1) ||
+        hdr->strtab_size == 0)
+        return -EINVAL;
+
+    rules = blob + hdr->rules_off;
+    dirs = blob + hdr->dirs_off;
+    children = blob + hdr->children_off;
+    strtab = blob + hdr->strtab_off;
+
+    for (i = 0; i < hdr->nr_rules; i++) {
+        const struct zeromount_img_rule *r = &rules[i];
+        const char *vp = zeromount_image_str(hdr, strtab, r->vp_off, r->vp_len);
+        const char *rp = zeromount_image_str(hdr, strtab, r->rp_off, r->rp_len);
+
+        if (!vp || !rp || r->vp_len < 2 || r->rp_len == 0 || vp[0] != '/' ||
+            vp[r->vp_len - 1] == '/' || r->vp_len >= PATH_MAX || r->rp_len >= PATH_MAX ||
+            (r->flags & ~ZM_IMG_RULE_FLAGS))
+            return -EINVAL;
+        // Sorted and unique: rules_ht lookups assume one rule per path
+        if (prev && strcmp(prev, vp) >= 0)
+            return -EINVAL;
+        // Blooms are taken as given: rehashing every path here would cost
+        // as much as building the image. A wrong one only hides its rule.
+        prev = vp;
+    }
+
+    for (i = 0; i < hdr->nr_dirs; i++) {
+        const struct zeromount_img_dir *d = &dirs[i];
+        const char *dp = zeromount_image_str(hdr, strtab, d->path_off, d->path_len);
+
+        if (!dp || d->path_len == 0 || dp[0] != '/' || d->path_len >= PATH_MAX ||
+            (d->path_len > 1 && dp[d->path_len - 1] == '/'))
+            return -EINVAL;
+        // Child ranges follow each other so no child is linked into two dirs
+        if (d->first_child != next_child ||
+            d->nr_children > hdr->nr_children - d->first_child)
+            return -EINVAL;
+        next_child += d->nr_children;
+
+        for (j = d->first_child; j < d->first_child + d->nr_children; j++) {
+            const struct zeromount_img_child *c = &children[j];
+            const char *name = zeromount_image_str(hdr, strtab, c->name_off, c->name_len);
+
+            if (!name || c->name_len == 0 || memchr(name, '/', c->name_len) ||
+                (c->d_type != DT_DIR && c->d_type != DT_REG))
+                return -EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+struct zeromount_image_resolve_ctx {
+    struct zeromount_image *img;
+    struct path root;
+    const struct cred *cred; /* loader's creds, applied in every worker */
+};
+
+static void zeromount_image_resolve_range(void *data, int start, int end)
+{
+    struct zeromount_image_resolve_ctx *ctx = data;
+    const struct cred *old_cred;
+    struct path path;
+    int i;
+
+    // Same as refresh: permission and LSM checks must see the loader
+    old_cred = override_creds(ctx->cred);
+    zm_enter();
+    for (i = start; i < end; i++) {
+        struct zeromount_rule *rule = &ctx->img->rules[i];
+
+        if (vfs_path_lookup(ctx->root.dentry, ctx->root.mnt, rule->real_path,
+                            LOOKUP_FOLLOW, &path) == 0) {
+            struct inode *inode = d_backing_inode(path.dentry);
+            if (inode) {
+                rule->real_ino = inode->i_ino;
+                rule->real_dev = inode->i_sb->s_dev;
+            }
+            path_put(&path);
+        }
+    }
+    zm_exit();
+    revert_creds(old_cred);
+}
+
+static int zeromount_ioctl_load_image(unsigned long arg)
+{
+    struct zeromount_image_ioctl req;
+    struct zeromount_image_resolve_ctx ctx;
+    const struct zeromount_img_header *hdr;
+    const struct zeromount_img_rule *irules;
+    const struct zeromount_img_dir *idirs;
+    const struct zeromount_img_child *ichildren;
+    struct zeromount_image *img;
+    const char *strtab;
+    void *blob;
+    size_t bytes;
+    u32 i, j;
+    int ret;
+
+    if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+        return -EFAULT;
+    if (req.size < sizeof(*hdr) || req.size > ZEROMOUNT_IMG_MAX_SIZE)
+        return -EINVAL;
+
+    blob = kvmalloc(req.size, GFP_KERNEL);
+    if (!blob)
+        return -ENOMEM;
+    if (copy_from_user(blob, req.data, req.size)) {
+        kvfree(blob);
+        return -EFAULT;
+    }
+
+    ret = zeromount_image_validate(blob, req.size);
+    if (ret) {
+        ZM_INFO("load_image: rejected image (%d)\n", ret);
+        kvfree(blob);
+        return ret;
+    }
+
+    hdr = blob;
+    irules = blob + hdr->rules_off;
+    idirs = blob + hdr->dirs_off;
+    ichildren = blob + hdr->children_off;
+    strtab = blob + hdr->strtab_off;
+
+    // Counts are bounded by the validated image size, so this cannot overflow
+    bytes = sizeof(*img) + (size_t)hdr->nr_rules * sizeof(*img->rules) +
+            (size_t)hdr->nr_dirs * sizeof(*img->dirs) +
+            (size_t)hdr->nr_children * sizeof(*img->children);
+    img = kvzalloc(bytes, GFP_KERNEL);
+    if (!img) {
+        kvfree(blob);
+        return -ENOMEM;
+    }
+    img->blob = blob;
+    img->rules = (struct zeromount_rule *)(img + 1);
+    img->dirs = (struct zeromount_dir_node *)(img->rules + hdr->nr_rules);
+    img->children = (struct zeromount_child_name *)(img->dirs + hdr->nr_dirs);
+    // One reference per linked rule and dir, plus ours until publication
+    atomic_set(&img->users, hdr->nr_rules + hdr->nr_dirs + 1);
+
+    for (i = 0; i < hdr->nr_rules; i++) {
+        struct zeromount_rule *rule = &img->rules[i];
+
+        rule->virtual_path = (char *)strtab + irules[i].vp_off;
+        rule->vp_len = irules[i].vp_len;
+        rule->real_path = (char *)strtab + irules[i].rp_off;
+        rule->flags = (irules[i].flags & ~ZM_IMG_RULE_NEW) | ZM_FLAG_ACTIVE;
+        rule->is_new = !!(irules[i].flags & ZM_IMG_RULE_NEW);
+        rule->image = img;
+    }
+
+    for (i = 0; i < hdr->nr_dirs; i++) {
+        struct zeromount_dir_node *dn = &img->dirs[i];
+
+        dn->dir_path = (char *)strtab + idirs[i].path_off;
+        dn->image = img;
+        INIT_LIST_HEAD(&dn->children_names);
+        for (j = idirs[i].first_child; j < idirs[i].first_child + idirs[i].nr_children; j++) {
+            struct zeromount_child_name *child = &img->children[j];
+
+            child->name = (char *)strtab + ichildren[j].name_off;
+            child->d_type = ichildren[j].d_type;
+            child->in_image = true;
+            list_add_tail(&child->list, &dn->children_names);
+        }
+    }
+
+    if (zm_ino_adb == 0)
+        zeromount_refresh_critical_inodes();
+
+    // Resolved relative to the loader's root, like ADD_RULE's kern_path
+    ctx.img = img;
+    get_fs_root(current->fs, &ctx.root);
+    ctx.cred = get_current_cred();
+    zeromount_parallel_for(hdr->nr_rules, zeromount_image_resolve_range, NULL, &ctx);
+    put_cred(ctx.cred);
+    path_put(&ctx.root);
+
+    spin_lock(&zeromount_lock);
+    zeromount_unlink_rules_and_dirs();
+
+    for (i = 0; i < hdr->nr_rules; i++) {
+        struct zeromount_rule *rule = &img->rules[i];
+
+        hash_add_rcu(zeromount_rules_ht, &rule->node,
+                     full_name_hash(NULL, rule->virtual_path, rule->vp_len));
+        if (rule->real_ino != 0)
+            hash_add_rcu(zeromount_ino_ht, &rule->ino_node, rule->real_ino ^ rule->real_dev);
+        list_add_tail(&rule->list, &zeromount_rules_list);
+
+        set_bit(irules[i].vp_bloom[0] & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom);
+        set_bit(irules[i].vp_bloom[1] & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom);
+        set_bit(irules[i].rp_bloom[0] & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom);
+        set_bit(irules[i].rp_bloom[1] & (ZEROMOUNT_BLOOM_SIZE - 1), zeromount_bloom);
+    }
+
+    for (i = 0; i < hdr->nr_dirs; i++) {
+        struct zeromount_dir_node *dn = &img->dirs[i];
+
+        hash_add_rcu(zeromount_dirs_ht, &dn->node,
+                     full_name_hash(NULL, dn->dir_path, idirs[i].path_len));
+    }
+    spin_unlock(&zeromount_lock);
+
+    ZM_INFO("load_image: %u rules, %u dirs, %u entries (%zu bytes)\n",
+            hdr->nr_rules, hdr->nr_dirs, hdr->nr_children, (size_t)req.size);
+
+    // Only touch the header before dropping our reference: a racing
+    // CLEAR_ALL may release the image as soon as it is published.
+    zeromount_image_put(img);
+    zeromount_force_refresh_all();
+    return 0;
+}
+
 static int zeromount_ioctl_list_rules(unsigned long arg) {
     struct zeromount_rule *rule;
     char *kbuf;
@@ -1189,6 +1761,7 @@ static long zeromount_ioctl(struct file *filp, unsigned int cmd, unsigned long a
     case ZEROMOUNT_IOC_DISABLE: return zeromount_ioctl_disable();
     case ZEROMOUNT_IOC_REFRESH: zeromount_force_refresh_all(); return 0;
     case ZEROMOUNT_IOC_GET_STATUS: return atomic_read(&zeromount_enabled);
+    case ZEROMOUNT_IOC_LOAD_IMAGE: return zeromount_ioctl_load_image(arg);
     default: return -EINVAL;
     }
 }
@@ -1214,8 +1787,18 @@ static ssize_t debug_store(struct kobject *kobj, struct kobj_attribute *attr,
 
 static struct kobj_attribute debug_attr = __ATTR(debug, 0600, debug_show, debug_store);
 
+static ssize_t refresh_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+    return sprintf(buf, "rules=%d parents=%d elapsed_us=%llu\n",
+                   READ_ONCE(zm_refresh_last_rules), READ_ONCE(zm_refresh_last_parents),
+                   div_u64(READ_ONCE(zm_refresh_last_ns), NSEC_PER_USEC));
+}
+
+static struct kobj_attribute refresh_attr = __ATTR(refresh, 0400, refresh_show, NULL);
+
 static struct attribute *zeromount_attrs[] = {
     &debug_attr.attr,
+    &refresh_attr.attr,
     NULL,
 };
 
@@ -1249,6 +1832,11 @@ static int __init __used zeromount_init(void) {
     ret = misc_register(&zeromount_device);
     if (ret) return ret;
 
+    zeromount_refresh_wq = alloc_workqueue("zeromount_refresh", WQ_UNBOUND,
+                                           ZM_REFRESH_MAX_WORKERS);
+    if (!zeromount_refresh_wq)
+        pr_warn("ZeroMount: refresh workqueue unavailable, refreshing serially\n");
+
     zeromount_kobj = kobject_create_and_add("zeromount", kernel_kobj);
     if (zeromount_kobj) {
         ret = sysfs_create_group(zeromount_kobj, &zeromount_attr_group);
@@ -79,6 +79,7 @@ extern int zeromount_debug_level;
 #define ZEROMOUNT_IOC_DISABLE     _IO(ZEROMOUNT_IOC_MAGIC, 9)
 #define ZEROMOUNT_IOC_REFRESH     _IO(ZEROMOUNT_IOC_MAGIC, 10)
 #define ZEROMOUNT_IOC_GET_STATUS  _IOR(ZEROMOUNT_IOC_MAGIC, 11, int)
+#define ZEROMOUNT_IOC_LOAD_IMAGE  _IOW(ZEROMOUNT_IOC_MAGIC, 12, struct zeromount_image_ioctl)
 #define MAX_LIST_BUFFER_SIZE (64 * 1024)
 
 struct zeromount_ioctl_data {
@@ -87,6 +88,84 @@ struct zeromount_ioctl_data {
     unsigned int flags;
 };
 
+/*
+ * Compiled rule image for ZEROMOUNT_IOC_LOAD_IMAGE. Generated in userspace
+ * whenever the module set changes, then installed at boot in one call; the
+ * image replaces every rule and injected directory entry (UIDs are kept).
+ *
+ * Layout (native endian, offsets from the start of the image, 4-byte aligned):
+ *
+ *   header | rules[nr_rules] | dirs[nr_dirs] | children[nr_children] | strtab
+ *
+ * - Every string lives in strtab, is NUL-terminated and has no embedded NUL.
+ * - Rules are sorted by virtual path (strcmp order, no duplicates). Virtual
+ *   paths are normalized the way ADD_RULE stores them: no "/system" prefix,
+ *   no trailing '/'. *_bloom are jhash(path, len, 0) and jhash(path, len, 1);
+ *   they are not rechecked, so a wrong value only makes that rule miss.
+ * - flags takes ZM_FLAG_* plus ZM_IMG_RULE_NEW for virtual paths that do not
+ *   exist on the real filesystem; the generator must stat them with ZeroMount
+ *   disabled. Any other bit makes the image invalid.
+ * - tools/zm-mkimage.c builds images from a rule list, offline or on device.
+ * - dirs lists every directory that gets injected entries, ancestors
+ *   included, each owning children[first_child .. first_child + nr_children).
+ *   Dir paths are absolute with no trailing '/' ("/" itself is allowed), and
+ *   child ranges are consecutive: each dir starts where the previous ended.
+ */
+#define ZEROMOUNT_IMG_MAGIC    0x474d495a /* "ZIMG" */
+#define ZEROMOUNT_IMG_VERSION  1
+#define ZEROMOUNT_IMG_MAX_SIZE (64 << 20)
+#define ZM_IMG_RULE_NEW        (1U << 31)
+/* Every bit an image rule may carry; anything else is rejected */
+#define ZM_IMG_RULE_FLAGS      (ZM_FLAG_ACTIVE | ZM_FLAG_IS_DIR | ZM_IMG_RULE_NEW)
+
+struct zeromount_image_ioctl {
+    const void __user *data;
+    __u64 size;
+};
+
+struct zeromount_img_header {
+    __u32 magic;
+    __u32 version;
+    __u32 size;
+    __u32 nr_rules;
+    __u32 nr_dirs;
+    __u32 nr_children;
+    __u32 rules_off;
+    __u32 dirs_off;
+    __u32 children_off;
+    __u32 strtab_off;
+    __u32 strtab_size;
+    __u32 reserved;
+};
+
+struct zeromount_img_rule {
+    __u32 vp_off;
+    __u32 vp_len;
+    __u32 rp_off;
+    __u32 rp_len;
+    __u32 vp_bloom[2];
+    __u32 rp_bloom[2];
+    __u32 flags;
+    __u32 reserved;
+};
+
+struct zeromount_img_dir {
+    __u32 path_off;
+    __u32 path_len;
+    __u32 first_child;
+    __u32 nr_children;
+};
+
+struct zeromount_img_child {
+    __u32 name_off;
+    __u16 name_len;
+    __u8  d_type;
+    __u8  reserved;
+};
+
+/* Rules, dirs and children adopted from a loaded image point into it */
+struct zeromount_image;
+
 struct zeromount_rule {
     struct hlist_node node;
     struct hlist_node ino_node;
@@ -98,6 +177,7 @@ struct zeromount_rule {
     dev_t real_dev;
     bool is_new;
     u32 flags;
+    struct zeromount_image *image;
     struct rcu_head rcu;
 };
 
@@ -105,6 +185,7 @@ struct zeromount_dir_node {
     struct hlist_node node;
     char *dir_path;
     struct list_head children_names;
+    struct zeromount_image *image;
     struct rcu_head rcu;
 };
 
@@ -112,6 +193,7 @@ struct zeromount_child_name {
     struct list_head list;
     char *name;
     unsigned char d_type;
+    bool in_image;
     struct rcu_head rcu;
 };
 
@@ -129,6 +211,16 @@ extern struct list_head zeromount_rules_list;
 extern spinlock_t zeromount_lock;
 extern unsigned long zeromount_bloom[];
 
+/*
+ * zeromount_name_class() bits: the getname_flags() verdict stored in a
+ * struct filename, 0 when that name was not classified (ZeroMount idle or
+ * skipping this task, or a getname_kernel() name).
+ */
+#define ZM_CLASS_VALID        (1U << 0)
+#define ZM_CLASS_ASCII        (1U << 1) /* no byte >= 0x80 */
+
+struct filename;
+
 #ifdef CONFIG_ZEROMOUNT
 extern atomic_t zeromount_enabled;
 
@@ -136,6 +228,7 @@ bool zeromount_should_skip(void);
 char *zeromount_resolve_path(const char *pathname);
 char *zeromount_build_absolute_path(int dfd, const char *name);
 struct filename *zeromount_getname_hook(struct filename *name);
+unsigned int zeromount_name_class(const struct filename *name);
 void zeromount_inject_dents64(struct file *file, void __user **dirent, int *count, loff_t *pos);
 void zeromount_inject_dents(struct file *file, void __user **dirent, int *count, loff_t *pos);
 char *zeromount_get_virtual_path_for_inode(struct inode *inode);
@@ -150,6 +243,7 @@ static inline bool zeromount_should_skip(void) { return true; }
 static inline char *zeromount_resolve_path(const char *p) { return NULL; }
 static inline char *zeromount_build_absolute_path(int dfd, const char *name) { return NULL; }
 static inline struct filename *zeromount_getname_hook(struct filename *name) { return name; }
+static inline unsigned int zeromount_name_class(const struct filename *name) { return 0; }
 static inline void zeromount_inject_dents64(struct file *f, void __user **d, int *c, loff_t *p) {}
 static inline void zeromount_inject_dents(struct file *f, void __user **d, int *c, loff_t *p) {}
 static inline char *zeromount_get_virtual_path_for_inode(struct inode *inode) { return NULL; }
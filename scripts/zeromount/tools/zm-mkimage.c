@@ -0,0 +1,565 @@
+/*
+ * zm-mkimage: build a ZeroMount rule image and optionally load it
+ *
+ * Reads one rule per line, "VIRTUAL REAL [FLAGS]", from RULES or stdin.
+ * FLAGS is a comma list of "new" (the virtual path does not exist on the
+ * real filesystem) and "dir" (the real path is a directory). Blank lines and
+ * lines starting with '#' are skipped; paths cannot contain whitespace.
+ *
+ *   -s         derive new/dir with stat() on this device instead of FLAGS;
+ *              with -l, ZeroMount is disabled while the paths are checked
+ *   -o IMAGE   write the image to IMAGE
+ *   -l DEVICE  install it with ZEROMOUNT_IOC_LOAD_IMAGE (e.g. /dev/zeromount)
+ *
+ * The layout follows the image comment in src/zeromount.h, which is the
+ * authority; the structs below must stay in sync with it.
+ *
+ * Build: cc -O2 -o zm-mkimage zm-mkimage.c (or the NDK's clang for the device)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#define ZEROMOUNT_IOC_MAGIC       'Z'
+#define ZEROMOUNT_IOC_DISABLE     _IO(ZEROMOUNT_IOC_MAGIC, 9)
+#define ZEROMOUNT_IOC_ENABLE      _IO(ZEROMOUNT_IOC_MAGIC, 8)
+#define ZEROMOUNT_IOC_GET_STATUS  _IOR(ZEROMOUNT_IOC_MAGIC, 11, int)
+#define ZEROMOUNT_IOC_LOAD_IMAGE  _IOW(ZEROMOUNT_IOC_MAGIC, 12, struct zeromount_image_ioctl)
+
+#define ZM_FLAG_ACTIVE         (1 << 0)
+#define ZM_FLAG_IS_DIR         (1 << 7)
+#define ZM_IMG_RULE_NEW        (1U << 31)
+
+#define ZEROMOUNT_IMG_MAGIC    0x474d495a /* "ZIMG" */
+#define ZEROMOUNT_IMG_VERSION  1
+#define ZEROMOUNT_IMG_MAX_SIZE (64 << 20)
+
+#define ZM_PATH_MAX 4096
+
+struct zeromount_image_ioctl {
+    const void *data;
+    uint64_t size;
+};
+
+struct zeromount_img_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t nr_rules;
+    uint32_t nr_dirs;
+    uint32_t nr_children;
+    uint32_t rules_off;
+    uint32_t dirs_off;
+    uint32_t children_off;
+    uint32_t strtab_off;
+    uint32_t strtab_size;
+    uint32_t reserved;
+};
+
+struct zeromount_img_rule {
+    uint32_t vp_off;
+    uint32_t vp_len;
+    uint32_t rp_off;
+    uint32_t rp_len;
+    uint32_t vp_bloom[2];
+    uint32_t rp_bloom[2];
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct zeromount_img_dir {
+    uint32_t path_off;
+    uint32_t path_len;
+    uint32_t first_child;
+    uint32_t nr_children;
+};
+
+struct zeromount_img_child {
+    uint32_t name_off;
+    uint16_t name_len;
+    uint8_t  d_type;
+    uint8_t  reserved;
+};
+
+_Static_assert(sizeof(struct zeromount_img_header) == 48, "header layout");
+_Static_assert(sizeof(struct zeromount_img_rule) == 40, "rule layout");
+_Static_assert(sizeof(struct zeromount_img_dir) == 16, "dir layout");
+_Static_assert(sizeof(struct zeromount_img_child) == 8, "child layout");
+
+struct rule {
+    char *vp;
+    char *rp;
+    uint32_t flags;
+};
+
+/* One injected entry: name inside dir, as zeromount_auto_inject_parent() adds it */
+struct entry {
+    char *dir;
+    char *name;
+    uint8_t d_type;
+};
+
+static struct rule *rules;
+static size_t nr_rules, cap_rules;
+static struct entry *entries;
+static size_t nr_entries, cap_entries;
+
+static void *xrealloc(void *p, size_t n)
+{
+    p = realloc(p, n);
+    if (!p) {
+        perror("zm-mkimage");
+        exit(1);
+    }
+    return p;
+}
+
+static char *xstrndup(const char *s, size_t n)
+{
+    char *p = strndup(s, n);
+    if (!p) {
+        perror("zm-mkimage");
+        exit(1);
+    }
+    return p;
+}
+
+/* Port of the kernel's jhash() (include/linux/jhash.h) */
+static uint32_t rol32(uint32_t w, unsigned int s)
+{
+    return (w << s) | (w >> (32 - s));
+}
+
+#define jhash_mix(a, b, c) do { \
+    a -= c; a ^= rol32(c, 4);  c += b; \
+    b -= a; b ^= rol32(a, 6);  a += c; \
+    c -= b; c ^= rol32(b, 8);  b += a; \
+    a -= c; a ^= rol32(c, 16); c += b; \
+    b -= a; b ^= rol32(a, 19); a += c; \
+    c -= b; c ^= rol32(b, 4);  b += a; \
+} while (0)
+
+#define jhash_final(a, b, c) do { \
+    c ^= b; c -= rol32(b, 14); \
+    a ^= c; a -= rol32(c, 11); \
+    b ^= a; b -= rol32(a, 25); \
+    c ^= b; c -= rol32(b, 16); \
+    a ^= c; a -= rol32(c, 4);  \
+    b ^= a; b -= rol32(a, 14); \
+    c ^= b; c -= rol32(b, 24); \
+} while (0)
+
+static uint32_t load32(const uint8_t *k)
+{
+    uint32_t v;
+    memcpy(&v, k, sizeof(v));
+    return v;
+}
+
+static uint32_t jhash(const void *key, uint32_t length, uint32_t initval)
+{
+    const uint8_t *k = key;
+    uint32_t a, b, c;
+
+    a = b = c = 0xdeadbeef + length + initval;
+    while (length > 12) {
+        a += load32(k);
+        b += load32(k + 4);
+        c += load32(k + 8);
+        jhash_mix(a, b, c);
+        length -= 12;
+        k += 12;
+    }
+    switch (length) {
+    case 12: c += (uint32_t)k[11] << 24; /* fall through */
+    case 11: c += (uint32_t)k[10] << 16; /* fall through */
+    case 10: c += (uint32_t)k[9] << 8;   /* fall through */
+    case 9:  c += k[8];                  /* fall through */
+    case 8:  b += (uint32_t)k[7] << 24;  /* fall through */
+    case 7:  b += (uint32_t)k[6] << 16;  /* fall through */
+    case 6:  b += (uint32_t)k[5] << 8;   /* fall through */
+    case 5:  b += k[4];                  /* fall through */
+    case 4:  a += (uint32_t)k[3] << 24;  /* fall through */
+    case 3:  a += (uint32_t)k[2] << 16;  /* fall through */
+    case 2:  a += (uint32_t)k[1] << 8;   /* fall through */
+    case 1:  a += k[0];
+        jhash_final(a, b, c);
+        break;
+    case 0:
+        break;
+    }
+    return c;
+}
+
+/* Same rules as zeromount_normalize_path() */
+static char *normalize(const char *path)
+{
+    size_t len;
+
+    // Android mounts system at both / and /system
+    if (strncmp(path, "/system/", 8) == 0)
+        path += 7;
+    len = strlen(path);
+    while (len > 1 && path[len - 1] == '/')
+        len--;
+    return xstrndup(path, len);
+}
+
+static int parse_flags(const char *s, uint32_t *flags)
+{
+    char *copy = xstrndup(s, strlen(s)), *save = NULL, *tok;
+    int ret = 0;
+
+    for (tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (strcmp(tok, "new") == 0)
+            *flags |= ZM_IMG_RULE_NEW;
+        else if (strcmp(tok, "dir") == 0)
+            *flags |= ZM_FLAG_IS_DIR;
+        else
+            ret = -1;
+    }
+    free(copy);
+    return ret;
+}
+
+static int read_rules(FILE *in, const char *name)
+{
+    char line[2 * ZM_PATH_MAX + 64];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), in)) {
+        char *save = NULL, *vp, *rp, *fl;
+        struct rule *r;
+
+        lineno++;
+        if (!strchr(line, '\n') && !feof(in)) {
+            fprintf(stderr, "%s:%d: line too long\n", name, lineno);
+            return -1;
+        }
+        vp = strtok_r(line, " \t\r\n", &save);
+        if (!vp || vp[0] == '#')
+            continue;
+        rp = strtok_r(NULL, " \t\r\n", &save);
+        fl = strtok_r(NULL, " \t\r\n", &save);
+        if (!rp || strtok_r(NULL, " \t\r\n", &save)) {
+            fprintf(stderr, "%s:%d: expected VIRTUAL REAL [FLAGS]\n", name, lineno);
+            return -1;
+        }
+
+        if (nr_rules == cap_rules) {
+            cap_rules = cap_rules ? cap_rules * 2 : 256;
+            rules = xrealloc(rules, cap_rules * sizeof(*rules));
+        }
+        r = &rules[nr_rules];
+        r->vp = normalize(vp);
+        r->rp = xstrndup(rp, strlen(rp));
+        r->flags = 0;
+        if (fl && parse_flags(fl, &r->flags) < 0) {
+            fprintf(stderr, "%s:%d: unknown flag in '%s'\n", name, lineno, fl);
+            return -1;
+        }
+        if (r->vp[0] != '/' || strlen(r->vp) < 2 || strlen(r->vp) >= ZM_PATH_MAX ||
+            strlen(r->rp) >= ZM_PATH_MAX) {
+            fprintf(stderr, "%s:%d: bad virtual path '%s'\n", name, lineno, vp);
+            return -1;
+        }
+        nr_rules++;
+    }
+    return ferror(in) ? -1 : 0;
+}
+
+/* What ADD_RULE would find: run with ZeroMount disabled */
+static void stat_rules(void)
+{
+    struct stat st;
+
+    for (size_t i = 0; i < nr_rules; i++) {
+        rules[i].flags &= ~(ZM_IMG_RULE_NEW | ZM_FLAG_IS_DIR);
+        if (stat(rules[i].vp, &st) < 0)
+            rules[i].flags |= ZM_IMG_RULE_NEW;
+        if (stat(rules[i].rp, &st) == 0 && S_ISDIR(st.st_mode))
+            rules[i].flags |= ZM_FLAG_IS_DIR;
+    }
+}
+
+static int compare_rule(const void *a, const void *b)
+{
+    return strcmp(((const struct rule *)a)->vp, ((const struct rule *)b)->vp);
+}
+
+static int compare_entry(const void *a, const void *b)
+{
+    const struct entry *x = a, *y = b;
+    int ret = strcmp(x->dir, y->dir);
+
+    return ret ? ret : strcmp(x->name, y->name);
+}
+
+static int is_new_rule(const char *vp)
+{
+    struct rule key = { .vp = (char *)vp };
+    struct rule *r = bsearch(&key, rules, nr_rules, sizeof(*rules), compare_rule);
+
+    return r && (r->flags & ZM_IMG_RULE_NEW);
+}
+
+/* Mirrors zeromount_auto_inject_parent(): walk up until "/" or a NEW parent */
+static void inject_parent(const char *path, uint8_t d_type)
+{
+    const char *slash = strrchr(path, '/');
+    char *parent;
+
+    if (!slash || slash == path)
+        return;
+    parent = xstrndup(path, slash - path);
+    // A redirected parent's real readdir already lists its children
+    if (is_new_rule(parent)) {
+        free(parent);
+        return;
+    }
+    inject_parent(parent, DT_DIR);
+
+    if (nr_entries == cap_entries) {
+        cap_entries = cap_entries ? cap_entries * 2 : 256;
+        entries = xrealloc(entries, cap_entries * sizeof(*entries));
+    }
+    entries[nr_entries].dir = parent;
+    entries[nr_entries].name = xstrndup(slash + 1, strlen(slash + 1));
+    entries[nr_entries].d_type = d_type;
+    nr_entries++;
+}
+
+static int build_rules(void)
+{
+    size_t out = 0;
+
+    qsort(rules, nr_rules, sizeof(*rules), compare_rule);
+    for (size_t i = 0; i < nr_rules; i++) {
+        if (out && strcmp(rules[out - 1].vp, rules[i].vp) == 0) {
+            fprintf(stderr, "duplicate virtual path %s\n", rules[i].vp);
+            return -1;
+        }
+        rules[out++] = rules[i];
+    }
+    nr_rules = out;
+
+    for (size_t i = 0; i < nr_rules; i++) {
+        if (rules[i].flags & ZM_IMG_RULE_NEW)
+            inject_parent(rules[i].vp, (rules[i].flags & ZM_FLAG_IS_DIR) ? DT_DIR : DT_REG);
+    }
+
+    // Group by dir; a name reached from several rules is injected once
+    qsort(entries, nr_entries, sizeof(*entries), compare_entry);
+    out = 0;
+    for (size_t i = 0; i < nr_entries; i++) {
+        if (out && compare_entry(&entries[out - 1], &entries[i]) == 0) {
+            free(entries[i].dir);
+            free(entries[i].name);
+            continue;
+        }
+        entries[out++] = entries[i];
+    }
+    nr_entries = out;
+    return 0;
+}
+
+static uint32_t add_string(char *strtab, uint32_t *used, const char *s)
+{
+    uint32_t off = *used;
+    size_t len = strlen(s) + 1;
+
+    memcpy(strtab + off, s, len);
+    *used += len;
+    return off;
+}
+
+static void *build_image(size_t *size_out)
+{
+    struct zeromount_img_header *hdr;
+    struct zeromount_img_rule *irules;
+    struct zeromount_img_dir *idirs;
+    struct zeromount_img_child *ichildren;
+    size_t nr_dirs = 0, strtab_size = 0, size;
+    uint32_t used = 0;
+    char *blob, *strtab;
+
+    for (size_t i = 0; i < nr_rules; i++)
+        strtab_size += strlen(rules[i].vp) + strlen(rules[i].rp) + 2;
+    for (size_t i = 0; i < nr_entries; i++) {
+        if (i == 0 || strcmp(entries[i - 1].dir, entries[i].dir) != 0) {
+            nr_dirs++;
+            strtab_size += strlen(entries[i].dir) + 1;
+        }
+        strtab_size += strlen(entries[i].name) + 1;
+    }
+    if (strtab_size == 0)
+        strtab_size = 1;
+
+    size = sizeof(*hdr) + nr_rules * sizeof(*irules) + nr_dirs * sizeof(*idirs) +
+           nr_entries * sizeof(*ichildren) + strtab_size;
+    if (size > ZEROMOUNT_IMG_MAX_SIZE) {
+        fprintf(stderr, "image is %zu bytes, over the %d byte limit\n", size,
+                ZEROMOUNT_IMG_MAX_SIZE);
+        return NULL;
+    }
+    blob = calloc(1, size);
+    if (!blob) {
+        perror("zm-mkimage");
+        return NULL;
+    }
+
+    // Every entry size is a multiple of 4, so each section stays aligned
+    hdr = (struct zeromount_img_header *)blob;
+    hdr->magic = ZEROMOUNT_IMG_MAGIC;
+    hdr->version = ZEROMOUNT_IMG_VERSION;
+    hdr->size = size;
+    hdr->nr_rules = nr_rules;
+    hdr->nr_dirs = nr_dirs;
+    hdr->nr_children = nr_entries;
+    hdr->rules_off = sizeof(*hdr);
+    hdr->dirs_off = hdr->rules_off + nr_rules * sizeof(*irules);
+    hdr->children_off = hdr->dirs_off + nr_dirs * sizeof(*idirs);
+    hdr->strtab_off = hdr->children_off + nr_entries * sizeof(*ichildren);
+    hdr->strtab_size = strtab_size;
+
+    irules = (struct zeromount_img_rule *)(blob + hdr->rules_off);
+    idirs = (struct zeromount_img_dir *)(blob + hdr->dirs_off);
+    ichildren = (struct zeromount_img_child *)(blob + hdr->children_off);
+    strtab = blob + hdr->strtab_off;
+
+    for (size_t i = 0; i < nr_rules; i++) {
+        struct zeromount_img_rule *r = &irules[i];
+
+        r->vp_len = strlen(rules[i].vp);
+        r->rp_len = strlen(rules[i].rp);
+        r->vp_off = add_string(strtab, &used, rules[i].vp);
+        r->rp_off = add_string(strtab, &used, rules[i].rp);
+        // Same hashes as zeromount_bloom_add()
+        r->vp_bloom[0] = jhash(rules[i].vp, r->vp_len, 0);
+        r->vp_bloom[1] = jhash(rules[i].vp, r->vp_len, 1);
+        r->rp_bloom[0] = jhash(rules[i].rp, r->rp_len, 0);
+        r->rp_bloom[1] = jhash(rules[i].rp, r->rp_len, 1);
+        r->flags = rules[i].flags | ZM_FLAG_ACTIVE;
+    }
+
+    nr_dirs = 0;
+    for (size_t i = 0; i < nr_entries; i++) {
+        struct zeromount_img_child *c = &ichildren[i];
+
+        if (i == 0 || strcmp(entries[i - 1].dir, entries[i].dir) != 0) {
+            struct zeromount_img_dir *d = &idirs[nr_dirs++];
+
+            d->path_len = strlen(entries[i].dir);
+            d->path_off = add_string(strtab, &used, entries[i].dir);
+            d->first_child = i;
+        }
+        idirs[nr_dirs - 1].nr_children++;
+        c->name_len = strlen(entries[i].name);
+        c->name_off = add_string(strtab, &used, entries[i].name);
+        c->d_type = entries[i].d_type;
+    }
+
+    *size_out = size;
+    return blob;
+}
+
+static int write_image(const char *path, const void *blob, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (fwrite(blob, 1, size, fp) != size || fclose(fp) != 0) {
+        fprintf(stderr, "%s: write failed\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: zm-mkimage [-s] [-o IMAGE] [-l DEVICE] [RULES]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = NULL, *device = NULL, *input = "-";
+    int do_stat = 0, dev_fd = -1, opt;
+    size_t size;
+    void *blob;
+    FILE *in;
+
+    while ((opt = getopt(argc, argv, "so:l:")) != -1) {
+        switch (opt) {
+        case 's': do_stat = 1; break;
+        case 'o': output = optarg; break;
+        case 'l': device = optarg; break;
+        default: usage();
+        }
+    }
+    if (optind < argc)
+        input = argv[optind++];
+    if (optind < argc || (!output && !device))
+        usage();
+
+    in = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+    if (!in) {
+        fprintf(stderr, "%s: %s\n", input, strerror(errno));
+        return 1;
+    }
+    if (read_rules(in, input) < 0)
+        return 1;
+    if (in != stdin)
+        fclose(in);
+
+    if (device) {
+        dev_fd = open(device, O_RDWR | O_CLOEXEC);
+        if (dev_fd < 0) {
+            fprintf(stderr, "%s: %s\n", device, strerror(errno));
+            return 1;
+        }
+    }
+    if (do_stat) {
+        // Live rules would make redirected paths look like they exist
+        int enabled = dev_fd >= 0 ? ioctl(dev_fd, ZEROMOUNT_IOC_GET_STATUS) : 0;
+
+        if (enabled > 0)
+            ioctl(dev_fd, ZEROMOUNT_IOC_DISABLE);
+        stat_rules();
+        if (enabled > 0)
+            ioctl(dev_fd, ZEROMOUNT_IOC_ENABLE);
+    }
+
+    if (build_rules() < 0)
+        return 1;
+    blob = build_image(&size);
+    if (!blob)
+        return 1;
+    if (output && write_image(output, blob, size) < 0)
+        return 1;
+
+    if (dev_fd >= 0) {
+        struct zeromount_image_ioctl req = { .data = blob, .size = size };
+
+        if (ioctl(dev_fd, ZEROMOUNT_IOC_LOAD_IMAGE, &req) < 0) {
+            fprintf(stderr, "LOAD_IMAGE: %s\n", strerror(errno));
+            return 1;
+        }
+        close(dev_fd);
+    }
+
+    printf("%zu rules, %zu injected entries, %zu bytes\n", nr_rules, nr_entries, size);
+    free(blob);
+    return 0;
+}